@@ -67,4 +67,8 @@ void setup() {
 	}
 }
 
-void loop() {}
+void loop() {
+	// Prints the library's trace events (errors, reconnects, uploads).
+	waavisTracePrint(Serial);
+	delay(100);
+}
@@ -0,0 +1,189 @@
+// Example: Benchmark WaavisClient against a stand-in server
+//
+// The stand-in answers send_chat, send_chat_link and send_chat_media like
+// api.waavis.com does, so the client can be measured without a real token.
+// It runs on a computer in the same network (extras/host: make, then
+// ./waavis_standin 8080), so the ESP32 only runs the client under test. Run
+// the sketch before and after a library change and compare the numbers.
+
+#if !defined(ESP32)
+#error "This example supports ESP32 only."
+#endif
+
+#include <WiFi.h>
+#include <Waavis.h>
+
+const char *ssid = "YOUR_WIFI_SSID";
+const char *password = "YOUR_WIFI_PASSWORD";
+
+// Address of the computer running waavis_standin.
+const char *standinUrl = "http://192.168.1.10:8080";
+const int iterations = 50;
+const size_t mediaSize = 32 * 1024;
+
+WaavisClient *waavis = nullptr;
+// Lowest free heap seen during the current run.
+uint32_t heapLow = 0;
+
+class PatternStream : public Stream {
+public:
+  explicit PatternStream(size_t length) : _length(length), _pos(0) {}
+
+  void rewind() {
+    _pos = 0;
+  }
+
+  int available() override {
+    return static_cast<int>(_length - _pos);
+  }
+
+  int read() override {
+    if (_pos >= _length) {
+      return -1;
+    }
+    return static_cast<uint8_t>(_pos++);
+  }
+
+  int peek() override {
+    if (_pos >= _length) {
+      return -1;
+    }
+    return static_cast<uint8_t>(_pos);
+  }
+
+  // The upload reads in blocks; without this, Stream::readBytes would go
+  // through read() byte by byte and the benchmark would measure that.
+  size_t readBytes(char *buffer, size_t length) override {
+    size_t n = 0;
+    while (n < length && _pos < _length) {
+      buffer[n++] = static_cast<char>(_pos++);
+    }
+    return n;
+  }
+
+  size_t write(uint8_t) override {
+    return 0;
+  }
+
+private:
+  size_t _length;
+  size_t _pos;
+};
+
+// Samples the free heap between calls and on every upload piece. With
+// WAAVIS_ENABLE_MEMORY_PROFILE the library's own per-call minimum is used
+// too, which also covers the phases of text requests.
+static void sampleHeap() {
+  uint32_t freeHeap = ESP.getFreeHeap();
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  if (waavis->lastMemoryProfile().freeMin < freeHeap) {
+    freeHeap = waavis->lastMemoryProfile().freeMin;
+  }
+#endif
+  if (freeHeap < heapLow) {
+    heapLow = freeHeap;
+  }
+}
+
+static bool sampleOnProgress(size_t, size_t, uint32_t, void *) {
+  sampleHeap();
+  return true;
+}
+
+static void beginRun() {
+  heapLow = ESP.getFreeHeap();
+}
+
+static void report(const char *name, unsigned long elapsedMs, int ok,
+                   size_t bytesPerCall, uint32_t heapBefore) {
+  float seconds = elapsedMs / 1000.0f;
+  Serial.printf("%-14s %3d/%d ok  %7.1f req/s", name, ok, iterations,
+                iterations / seconds);
+  if (bytesPerCall > 0) {
+    Serial.printf("  %8.1f KB/s", bytesPerCall * iterations / 1024.0f / seconds);
+  }
+  Serial.printf("  heap delta %ld B  low water %u B\n",
+                static_cast<long>(ESP.getFreeHeap()) - static_cast<long>(heapBefore),
+                heapLow);
+}
+
+static void printStats(const char *name, WaavisEndpoint endpoint) {
+  const WaavisEndpointStats &stats = waavis->stats(endpoint);
+  Serial.printf("%-14s max %u ms, histogram:", name, stats.maxMs);
+  for (size_t i = 0; i < WAAVIS_HISTOGRAM_BUCKETS; ++i) {
+    if (stats.histogram[i] > 0) {
+      Serial.printf(" <%lums:%u", 16UL << i, stats.histogram[i]);
+    }
+  }
+  Serial.println();
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(200);
+
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+    Serial.print('.');
+  }
+  Serial.println();
+
+  waavis = new WaavisClient(standinUrl);
+  waavis->onUploadProgress(sampleOnProgress);
+  Serial.println("Benchmark against " + String(standinUrl));
+
+  String message;
+  for (int i = 0; i < 64; ++i) {
+    message += "Halo dari benchmark ";
+  }
+  PatternStream media(mediaSize);
+
+  // Warm up the connection so the first sample does not include connect().
+  waavis->sendChatPost("TOKEN", "628000000000", "warm-up");
+  waavis->resetStats();
+
+  uint32_t heapBefore = ESP.getFreeHeap();
+  beginRun();
+  unsigned long start = millis();
+  int ok = 0;
+  for (int i = 0; i < iterations; ++i) {
+    ok += waavis->sendChatPost("TOKEN", "628000000000", message, true) ? 1 : 0;
+    sampleHeap();
+  }
+  report("sendChatPost", millis() - start, ok, 0, heapBefore);
+
+  heapBefore = ESP.getFreeHeap();
+  beginRun();
+  start = millis();
+  ok = 0;
+  for (int i = 0; i < iterations; ++i) {
+    ok += waavis->sendChatLink("TOKEN", "628000000000", message, true,
+                               "https://waavis.com", "Waavis API",
+                               "WhatsApp API Service")
+              ? 1
+              : 0;
+    sampleHeap();
+  }
+  report("sendChatLink", millis() - start, ok, 0, heapBefore);
+
+  heapBefore = ESP.getFreeHeap();
+  beginRun();
+  start = millis();
+  ok = 0;
+  for (int i = 0; i < iterations; ++i) {
+    media.rewind();
+    ok += waavis->sendChatMedia("TOKEN", "628000000000", "bench", false, "image",
+                                media, mediaSize, "bench.bin")
+              ? 1
+              : 0;
+    sampleHeap();
+  }
+  report("sendChatMedia", millis() - start, ok, mediaSize, heapBefore);
+
+  printStats("send_chat", WaavisEndpoint::SendChat);
+  printStats("send_chat_link", WaavisEndpoint::SendChatLink);
+  printStats("send_chat_media", WaavisEndpoint::SendChatMedia);
+}
+
+void loop() {}
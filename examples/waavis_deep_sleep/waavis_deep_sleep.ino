@@ -0,0 +1,61 @@
+// Example: Battery node that wakes, sends one message and sleeps again
+//
+// resumeWiFi() reuses the access point, IP lease, server address and (on
+// ESP8266) TLS session saved by saveResumeState() before the last sleep, so
+// most wakes skip the scan, DHCP, DNS and a full handshake.
+// ESP8266: connect GPIO16 to RST so the timer can wake the board.
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#elif defined(ESP32)
+#include <WiFi.h>
+#else
+#error "This example supports ESP8266 and ESP32 only."
+#endif
+
+#include <Waavis.h>
+
+const char *ssid = "YOUR_WIFI_SSID";
+const char *password = "YOUR_WIFI_PASSWORD";
+
+const char *deviceToken = "DEVICE_TOKEN";
+const char *destination = "628xxxxxx";
+
+const uint64_t sleepMicros = 15ULL * 60 * 1000000;
+
+WaavisClient waavis;
+
+static void sleepNow() {
+#if defined(ESP8266)
+  ESP.deepSleep(sleepMicros);
+#else
+  esp_sleep_enable_timer_wakeup(sleepMicros);
+  esp_deep_sleep_start();
+#endif
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  if (!waavis.resumeWiFi(ssid, password)) {
+    Serial.println("WiFi failed");
+    sleepNow();
+  }
+
+  bool ok = waavis.sendChatPost(deviceToken, destination, "Sensor: 23.5 C");
+  if (!ok) {
+    Serial.print("sendChatPost failed: ");
+    Serial.println(waavis.lastError());
+  }
+
+  const WaavisWakeReport &report = waavis.wakeReport();
+  Serial.printf("wake -> WiFi %lu ms, -> ack %lu ms (fast WiFi %d, cached IP %d, TLS session %d)\n",
+                static_cast<unsigned long>(report.wifiMs),
+                static_cast<unsigned long>(report.ackMs), report.fastWiFi,
+                report.serverIpRestored, report.tlsSessionRestored);
+
+  waavis.saveResumeState();
+  sleepNow();
+}
+
+void loop() {}
@@ -1,4 +1,11 @@
-// Example: Capture ESP32 camera frame and send as media
+// Example: Capture ESP32 camera frames and send them as media
+//
+// A frame is sent every frameIntervalMs, or right away when a PIR sensor or
+// button on triggerPin goes high.
+//
+// With PSRAM the camera gets two frame buffers: while frame N is uploaded
+// from its buffer by the Waavis worker task, frame N+1 is captured into the
+// other one. Frames are sent straight from camera memory, without copying.
 
 #if !defined(ESP32)
 #error "This example supports ESP32 only."
@@ -14,43 +21,25 @@ const char *password = "YOUR_WIFI_PASSWORD";
 const char *deviceToken = "DEVICE_TOKEN";
 const char *destination = "628xxxxxx";
 
-WaavisClient waavis;
-
-class BufferStream : public Stream {
-public:
-  BufferStream(const uint8_t *data, size_t length)
-      : _data(data), _length(length), _pos(0) {}
-
-  int available() override {
-    return static_cast<int>(_length - _pos);
-  }
-
-  int read() override {
-    if (_pos >= _length) {
-      return -1;
-    }
-    return _data[_pos++];
-  }
-
-  int peek() override {
-    if (_pos >= _length) {
-      return -1;
-    }
-    return _data[_pos];
-  }
+// Time between two frames sent on the timer.
+const unsigned long frameIntervalMs = 60000;
+// GPIO of a PIR sensor or button (active high), -1 for the timer only.
+// Triggered frames are still at least triggerGapMs apart.
+const int triggerPin = -1;
+const unsigned long triggerGapMs = 5000;
 
-  size_t write(uint8_t) override {
-    return 0;
-  }
+WaavisClient waavis;
 
-private:
-  const uint8_t *_data;
-  size_t _length;
-  size_t _pos;
-};
+camera_fb_t *uploading = nullptr;
+uint32_t uploadTicket = 0;
+uint32_t framesSent = 0;
+unsigned long windowStart = 0;
+unsigned long lastFrame = 0;
+bool cameraReady = false;
+int frameBufferCount = 1;
 
 static bool initCamera() {
-  camera_config_t config;
+  camera_config_t config = {};
   config.ledc_channel = LEDC_CHANNEL_0;
   config.ledc_timer = LEDC_TIMER_0;
   config.pin_d0 = 5;
@@ -76,12 +65,16 @@ static bool initCamera() {
     config.frame_size = FRAMESIZE_VGA;
     config.jpeg_quality = 12;
     config.fb_count = 2;
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    config.grab_mode = CAMERA_GRAB_LATEST;
   } else {
     config.frame_size = FRAMESIZE_CIF;
     config.jpeg_quality = 12;
     config.fb_count = 1;
+    config.fb_location = CAMERA_FB_IN_DRAM;
   }
 
+  frameBufferCount = config.fb_count;
   return esp_camera_init(&config) == ESP_OK;
 }
 
@@ -101,33 +94,83 @@ void setup() {
     Serial.println("Camera init failed");
     return;
   }
+  if (!waavis.beginAsync()) {
+    Serial.print("Async start failed: ");
+    Serial.println(waavis.lastError());
+    return;
+  }
+  if (triggerPin >= 0) {
+    pinMode(triggerPin, INPUT);
+  }
+  cameraReady = true;
+  windowStart = millis();
+}
+
+// Waits for the upload in flight and gives its frame back to the camera.
+static void finishUpload() {
+  if (uploading == nullptr) {
+    return;
+  }
+  WaavisSendStatus status;
+  while ((status = waavis.sendStatus(uploadTicket)) == WaavisSendStatus::Queued ||
+         status == WaavisSendStatus::Running) {
+    delay(1);
+  }
+  if (status == WaavisSendStatus::Done) {
+    ++framesSent;
+  } else {
+    Serial.print("sendChatMediaBuffer failed: ");
+    Serial.println(waavis.sendError(uploadTicket));
+  }
+  esp_camera_fb_return(uploading);
+  uploading = nullptr;
+}
 
+void loop() {
+  if (!cameraReady) {
+    return;
+  }
+  // Give the frame back as soon as its upload ends.
+  if (uploading != nullptr) {
+    WaavisSendStatus status = waavis.sendStatus(uploadTicket);
+    if (status != WaavisSendStatus::Queued && status != WaavisSendStatus::Running) {
+      finishUpload();
+    }
+  }
+  if (millis() - windowStart >= 60000) {
+    Serial.print("Frames per minute: ");
+    Serial.println(framesSent);
+    framesSent = 0;
+    windowStart = millis();
+  }
+
+  unsigned long since = millis() - lastFrame;
+  bool triggered = triggerPin >= 0 && digitalRead(triggerPin) == HIGH &&
+                   since >= triggerGapMs;
+  if (since < frameIntervalMs && !triggered) {
+    return;
+  }
+  lastFrame = millis();
+
+  // Captures into the free buffer while the previous frame is still
+  // uploading. With a single frame buffer, release it first.
+  if (frameBufferCount < 2) {
+    finishUpload();
+  }
   camera_fb_t *fb = esp_camera_fb_get();
+  finishUpload();
   if (!fb) {
     Serial.println("Camera capture failed");
     return;
   }
 
-  BufferStream stream(fb->buf, fb->len);
-  bool ok = waavis.sendChatMedia(
-    deviceToken,
-    destination,
-    "Halo",
-    false,
-    "image",
-    stream,
-    fb->len,
-    "esp32.jpg"
-  );
-
-  esp_camera_fb_return(fb);
-
-  if (ok) {
-    Serial.println("sendChatMedia OK");
-  } else {
-    Serial.print("sendChatMedia failed: ");
-    Serial.println(waavis.lastError());
+  uploadTicket = waavis.sendChatMediaBufferAsync(deviceToken, destination,
+                                                 "Gerakan terdeteksi", false,
+                                                 "image", fb->buf, fb->len,
+                                                 "esp32.jpg");
+  if (uploadTicket == 0) {
+    esp_camera_fb_return(fb);
+    return;
   }
+  uploading = fb;
 }
-
-void loop() {}
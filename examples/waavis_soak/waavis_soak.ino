@@ -0,0 +1,92 @@
+// Example: Soak test for heap leaks and fragmentation
+//
+// Sends soakIterations messages back to back and prints the heap every
+// reportEvery sends. A library that neither leaks nor fragments keeps free
+// heap and the largest free block flat after the first report. Point
+// baseUrl at a test server (e.g. a stand-in on your LAN) rather than the
+// real API for runs of thousands of sends.
+//
+// Build with -DWAAVIS_ENABLE_MEMORY_PROFILE=1 to also print the heap profile
+// of the last call in each window.
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#elif defined(ESP32)
+#include <WiFi.h>
+#else
+#error "This example supports ESP8266 and ESP32 only."
+#endif
+
+#include <Waavis.h>
+
+const char *ssid = "YOUR_WIFI_SSID";
+const char *password = "YOUR_WIFI_PASSWORD";
+
+const char *baseUrl = "http://192.168.1.10:8080";
+const char *deviceToken = "DEVICE_TOKEN";
+const char *destination = "628xxxxxx";
+
+const uint32_t soakIterations = 5000;
+const uint32_t reportEvery = 250;
+
+WaavisClient waavis(baseUrl);
+
+static void readHeap(uint32_t &freeBytes, uint32_t &largest) {
+#if defined(ESP8266)
+  uint8_t fragmentation;
+  ESP.getHeapStats(&freeBytes, &largest, &fragmentation);
+#else
+  freeBytes = ESP.getFreeHeap();
+  largest = ESP.getMaxAllocHeap();
+#endif
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(200);
+
+  WiFi.begin(ssid, password);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+    Serial.print('.');
+  }
+  Serial.println();
+
+  uint32_t baseFree = 0;
+  uint32_t baseLargest = 0;
+  uint32_t failures = 0;
+  for (uint32_t i = 1; i <= soakIterations; ++i) {
+    String message = "Soak " + String(i);
+    if (!waavis.sendChatPost(deviceToken, destination, message)) {
+      ++failures;
+    }
+    if (i % reportEvery != 0) {
+      continue;
+    }
+
+    uint32_t freeBytes;
+    uint32_t largest;
+    readHeap(freeBytes, largest);
+    if (baseFree == 0) {
+      // The first window absorbs one-time allocations (TLS, DNS, buffers).
+      baseFree = freeBytes;
+      baseLargest = largest;
+    }
+    uint32_t fragmentation = freeBytes == 0 ? 0 : 100 - largest * 100 / freeBytes;
+    Serial.printf("%6u sends  %3u failed  free %6u (%+ld)  largest %6u (%+ld)  frag %2u%%\n",
+                  i, failures, freeBytes,
+                  static_cast<long>(freeBytes) - static_cast<long>(baseFree), largest,
+                  static_cast<long>(largest) - static_cast<long>(baseLargest),
+                  fragmentation);
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+    const WaavisMemoryProfile &profile = waavis.lastMemoryProfile();
+    Serial.printf("        last call: free %u -> %u (min %u), largest %u -> %u (min %u), blocks %+ld\n",
+                  profile.freeBefore, profile.freeAfter, profile.freeMin,
+                  profile.largestBefore, profile.largestAfter, profile.largestMin,
+                  static_cast<long>(profile.blocksDelta));
+#endif
+  }
+  Serial.println("Soak test done");
+}
+
+void loop() {}
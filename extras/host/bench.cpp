@@ -0,0 +1,246 @@
+// Benchmark of WaavisClient on Linux against the loopback stand-in server.
+// Run it before and after a library change and compare the numbers:
+//
+//   ./waavis_bench [iterations] [media KB] [base URL]
+//
+// With a base URL the stand-in is not started and that server is used.
+
+#include <Waavis.h>
+#include <errno.h>
+#include <malloc.h>
+
+#include "standin.h"
+
+// Heap use of the calling thread. malloc and friends are replaced below, so
+// every allocation made by the library, the shim and libc is seen; the
+// stand-in server runs on other threads and is not counted.
+struct HeapCounter {
+  bool enabled;
+  uint64_t allocations;
+  uint64_t bytes;
+  int64_t live;
+  int64_t peak;
+};
+
+static __thread HeapCounter heapCounter;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+
+static void *counted(void *pointer) {
+  if (pointer != nullptr && heapCounter.enabled) {
+    size_t size = malloc_usable_size(pointer);
+    ++heapCounter.allocations;
+    heapCounter.bytes += size;
+    heapCounter.live += static_cast<int64_t>(size);
+    if (heapCounter.live > heapCounter.peak) {
+      heapCounter.peak = heapCounter.live;
+    }
+  }
+  return pointer;
+}
+
+static void released(void *pointer) {
+  if (pointer != nullptr && heapCounter.enabled) {
+    heapCounter.live -= static_cast<int64_t>(malloc_usable_size(pointer));
+  }
+}
+
+void *malloc(size_t size) {
+  return counted(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size) {
+  return counted(__libc_calloc(count, size));
+}
+
+void *realloc(void *pointer, size_t size) {
+  size_t before = pointer != nullptr ? malloc_usable_size(pointer) : 0;
+  void *moved = __libc_realloc(pointer, size);
+  if (moved == nullptr && size != 0) {
+    return nullptr;
+  }
+  if (heapCounter.enabled) {
+    heapCounter.live -= static_cast<int64_t>(before);
+  }
+  return counted(moved);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  return counted(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  return counted(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+  void *pointer = __libc_memalign(alignment, size);
+  if (pointer == nullptr) {
+    return ENOMEM;
+  }
+  *out = counted(pointer);
+  return 0;
+}
+
+void free(void *pointer) {
+  released(pointer);
+  __libc_free(pointer);
+}
+}
+
+class PatternStream : public Stream {
+public:
+  explicit PatternStream(size_t length) : _length(length), _pos(0) {}
+
+  void rewind() {
+    _pos = 0;
+  }
+
+  int available() override {
+    return static_cast<int>(_length - _pos);
+  }
+
+  int read() override {
+    return _pos < _length ? static_cast<uint8_t>(_pos++) : -1;
+  }
+
+  int peek() override {
+    return _pos < _length ? static_cast<uint8_t>(_pos) : -1;
+  }
+
+  // The upload reads in blocks; without this, Stream::readBytes would go
+  // through read() byte by byte and the benchmark would measure that.
+  size_t readBytes(char *buffer, size_t length) override {
+    size_t n = 0;
+    while (n < length && _pos < _length) {
+      buffer[n++] = static_cast<char>(_pos++);
+    }
+    return n;
+  }
+
+  size_t write(uint8_t) override {
+    return 0;
+  }
+
+private:
+  size_t _length;
+  size_t _pos;
+};
+
+static int iterations = 200;
+static size_t mediaSize = 32 * 1024;
+static WaavisClient *waavis = nullptr;
+
+template <typename Call>
+static void measure(const char *name, size_t calls, size_t bytesPerCall, Call call) {
+  heapCounter = HeapCounter();
+  heapCounter.enabled = true;
+  unsigned long start = micros();
+  size_t ok = 0;
+  for (int i = 0; i < iterations; ++i) {
+    ok += call();
+  }
+  unsigned long elapsedUs = micros() - start;
+  heapCounter.enabled = false;
+
+  double seconds = elapsedUs / 1e6;
+  double requests = static_cast<double>(calls) * iterations;
+  printf("%-22s %5zu/%-5.0f %9.1f", name, ok, requests, requests / seconds);
+  if (bytesPerCall > 0) {
+    printf(" %10.1f", bytesPerCall * requests / 1024.0 / seconds);
+  } else {
+    printf(" %10s", "-");
+  }
+  printf(" %9.1f %10.1f %9lld\n", heapCounter.allocations / requests,
+         heapCounter.bytes / requests, static_cast<long long>(heapCounter.peak));
+  if (ok != requests) {
+    printf("  last error: %s\n", waavis->lastError().c_str());
+  }
+}
+
+static void printStats(const char *name, WaavisEndpoint endpoint) {
+  const WaavisEndpointStats &stats = waavis->stats(endpoint);
+  printf("%-16s max %u ms, histogram:", name, static_cast<unsigned>(stats.maxMs));
+  for (size_t i = 0; i < WAAVIS_HISTOGRAM_BUCKETS; ++i) {
+    if (stats.histogram[i] > 0) {
+      printf(" <%lums:%u", 16UL << i, static_cast<unsigned>(stats.histogram[i]));
+    }
+  }
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    iterations = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    mediaSize = static_cast<size_t>(atol(argv[2])) * 1024;
+  }
+  String baseUrl;
+  static WaavisStandin server;
+  if (argc > 3) {
+    baseUrl = argv[3];
+  } else {
+    if (!standinStart(server, 0, false)) {
+      perror("stand-in");
+      return 1;
+    }
+    standinServeInBackground(server);
+    baseUrl = "http://127.0.0.1:" + String(static_cast<unsigned int>(server.port));
+  }
+  waavis = new WaavisClient(baseUrl);
+  printf("Benchmark against %s, %d iterations, %zu KB media\n\n", baseUrl.c_str(),
+         iterations, mediaSize / 1024);
+
+  String message;
+  for (int i = 0; i < 64; ++i) {
+    message += "Halo dari benchmark ";
+  }
+  PatternStream media(mediaSize);
+  uint8_t *buffer = static_cast<uint8_t *>(malloc(mediaSize));
+  for (size_t i = 0; i < mediaSize; ++i) {
+    buffer[i] = static_cast<uint8_t>(i);
+  }
+  static const size_t kBatch = 10;
+  String recipients[kBatch];
+  for (size_t i = 0; i < kBatch; ++i) {
+    recipients[i] = "62800000000" + String(static_cast<unsigned int>(i));
+  }
+
+  // Warm up the connection so the first sample does not include connect().
+  waavis->sendChatPost("TOKEN", "628000000000", "warm-up");
+  waavis->resetStats();
+
+  printf("%-22s %11s %9s %10s %9s %10s %9s\n", "call", "ok", "req/s", "KB/s",
+         "allocs", "alloc B", "peak B");
+  measure("sendChatPost", 1, 0, [&] {
+    return waavis->sendChatPost("TOKEN", "628000000000", message, true);
+  });
+  measure("sendChatLink", 1, 0, [&] {
+    return waavis->sendChatLink("TOKEN", "628000000000", message, true,
+                                "https://waavis.com", "Waavis API", "WhatsApp API Service");
+  });
+  measure("sendChatBatch x10", kBatch, 0, [&] {
+    return waavis->sendChatBatch("TOKEN", recipients, kBatch, message, true);
+  });
+  measure("sendChatMedia", 1, mediaSize, [&] {
+    media.rewind();
+    return waavis->sendChatMedia("TOKEN", "628000000000", "bench", false, "image", media,
+                                 mediaSize, "bench.bin");
+  });
+  measure("sendChatMediaBuffer", 1, mediaSize, [&] {
+    return waavis->sendChatMediaBuffer("TOKEN", "628000000000", "bench", false, "image",
+                                       buffer, mediaSize, "bench.bin");
+  });
+  printf("\n");
+  printStats("send_chat", WaavisEndpoint::SendChat);
+  printStats("send_chat_link", WaavisEndpoint::SendChatLink);
+  printStats("send_chat_media", WaavisEndpoint::SendChatMedia);
+  free(buffer);
+  return 0;
+}
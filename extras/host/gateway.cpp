@@ -0,0 +1,106 @@
+#include "gateway.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+// poll() runs a send until it has to wait for the socket (or a media
+// stream); the budget only bounds a slow upload.
+static const unsigned long kPollBudgetMs = 1000;
+// Waiting sends are also polled this often, for the response timeout and
+// sends that wait on something other than their socket.
+static const unsigned long kSweepMs = 100;
+
+WaavisGateway::WaavisGateway()
+    : _epoll(epoll_create1(EPOLL_CLOEXEC)), _lastSweep(0), _callback(nullptr),
+      _callbackArg(nullptr) {}
+
+WaavisGateway::~WaavisGateway() {
+  if (_epoll >= 0) {
+    close(_epoll);
+  }
+}
+
+size_t WaavisGateway::add(WaavisClient &client, WiFiClient &transport) {
+  _slots.push_back({&client, &transport, false});
+  return _slots.size() - 1;
+}
+
+void WaavisGateway::onSendComplete(WaavisGatewayCallback callback, void *arg) {
+  _callback = callback;
+  _callbackArg = arg;
+}
+
+void WaavisGateway::step(size_t index) {
+  Slot &slot = _slots[index];
+  WaavisPollResult result = slot.client->poll(kPollBudgetMs);
+  int fd = slot.transport->fd();
+  if (result == WaavisPollResult::InProgress) {
+    slot.waiting = true;
+    if (fd >= 0) {
+      // The send may have reconnected, and a closed socket leaves the epoll
+      // set by itself, so register every time rather than track the fd.
+      // Connecting, the TLS handshake and a full send buffer wait for the
+      // socket to turn writable, the response for it to turn readable.
+      epoll_event event;
+      event.events = (slot.transport->waitEvents() == POLLOUT ? EPOLLOUT : EPOLLIN) |
+                     EPOLLRDHUP;
+      event.data.u64 = index;
+      if (epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &event) != 0 && errno == ENOENT) {
+        epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event);
+      }
+    }
+    return;
+  }
+  slot.waiting = false;
+  // An idle kept-alive socket turns readable when the server closes it;
+  // only sockets with a send in progress stay in the set.
+  if (fd >= 0) {
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+  }
+  if (result != WaavisPollResult::Idle && _callback != nullptr) {
+    _callback(index, result == WaavisPollResult::Done, _callbackArg);
+  }
+}
+
+size_t WaavisGateway::run(unsigned long timeoutMs) {
+  // Sends begun since the last run, and those the previous sweep resumed.
+  bool waiting = false;
+  for (size_t i = 0; i < _slots.size(); ++i) {
+    if (!_slots[i].waiting && _slots[i].client->sendInProgress()) {
+      step(i);
+    }
+    waiting = waiting || _slots[i].waiting;
+  }
+
+  if (waiting) {
+    epoll_event events[64];
+    unsigned long sinceSweep = millis() - _lastSweep;
+    unsigned long wait = sinceSweep >= kSweepMs ? 0 : kSweepMs - sinceSweep;
+    int ready = epoll_wait(_epoll, events, 64,
+                           static_cast<int>(wait < timeoutMs ? wait : timeoutMs));
+    for (int i = 0; i < ready; ++i) {
+      size_t index = static_cast<size_t>(events[i].data.u64);
+      if (_slots[index].waiting) {
+        _slots[index].waiting = false;
+        step(index);
+      }
+    }
+    if (millis() - _lastSweep >= kSweepMs) {
+      _lastSweep = millis();
+      for (size_t i = 0; i < _slots.size(); ++i) {
+        if (_slots[i].waiting) {
+          _slots[i].waiting = false;
+          step(i);
+        }
+      }
+    }
+  }
+
+  size_t busy = 0;
+  for (const Slot &slot : _slots) {
+    busy += slot.client->sendInProgress() ? 1 : 0;
+  }
+  return busy;
+}
@@ -0,0 +1,51 @@
+#ifndef WAAVIS_HOST_GATEWAY_H
+#define WAAVIS_HOST_GATEWAY_H
+
+#include <Waavis.h>
+
+#include <vector>
+
+typedef void (*WaavisGatewayCallback)(size_t index, bool ok, void *arg);
+
+// Runs the step-based sends (begin*() and poll()) of many WaavisClients on
+// one thread. Each client sends through its own WiFiClient or
+// WiFiClientSecure, set up with setNonBlockingConnect(true) and passed to
+// setTransport(transport, true). Connecting, the TLS handshake, writing the
+// request and reading the response then never wait: while the clients wait
+// on their sockets the thread sleeps in epoll_wait() on all of them, and a
+// client is polled again when its socket is ready. Name resolution inside
+// connect() still blocks; use IP addresses for many hosts.
+class WaavisGateway {
+public:
+  WaavisGateway();
+  ~WaavisGateway();
+  WaavisGateway(const WaavisGateway &) = delete;
+  WaavisGateway &operator=(const WaavisGateway &) = delete;
+
+  // Returns the client's index. client must send through transport (a
+  // blocking transport works too, but then waits inside run()); both must
+  // outlive the gateway.
+  size_t add(WaavisClient &client, WiFiClient &transport);
+  // Called when a send ends, from run(). It may begin the next send.
+  void onSendComplete(WaavisGatewayCallback callback, void *arg = nullptr);
+  // Polls the clients with a send in progress, waiting at most timeoutMs
+  // for a response to arrive. Returns the number of sends still in progress.
+  size_t run(unsigned long timeoutMs);
+
+private:
+  struct Slot {
+    WaavisClient *client;
+    WiFiClient *transport;
+    bool waiting;  // blocked on the server; polled again once readable
+  };
+
+  void step(size_t index);
+
+  int _epoll;
+  std::vector<Slot> _slots;
+  unsigned long _lastSweep;
+  WaavisGatewayCallback _callback;
+  void *_callbackArg;
+};
+
+#endif
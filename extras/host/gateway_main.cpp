@@ -0,0 +1,112 @@
+// Many concurrent sends from one thread through WaavisGateway:
+//
+//   ./waavis_gateway [clients] [messages] [delay ms] [base URL [insecure]]
+//
+// Each client sends its messages one after another over its own keep-alive
+// connection. Without a base URL a loopback stand-in is started that holds
+// every response for the delay (default 20 ms). An https URL is checked
+// against the system's CA store unless "insecure" follows it.
+
+#include <Waavis.h>
+
+#include <memory>
+
+#include "gateway.h"
+#include "standin.h"
+
+struct Run {
+  std::vector<std::unique_ptr<WaavisClient>> clients;
+  int messages;
+  std::vector<int> left;
+  size_t ok;
+  size_t failed;
+  String message;
+};
+
+static bool sendNext(Run &run, size_t index) {
+  if (run.left[index] == 0) {
+    return false;
+  }
+  --run.left[index];
+  String to = "62800000" + String(static_cast<unsigned int>(index));
+  if (!run.clients[index]->beginChatPost("TOKEN", to, run.message)) {
+    ++run.failed;
+    printf("client %zu: %s\n", index, run.clients[index]->lastError().c_str());
+    return false;
+  }
+  return true;
+}
+
+static void sendComplete(size_t index, bool ok, void *arg) {
+  Run &run = *static_cast<Run *>(arg);
+  if (ok) {
+    ++run.ok;
+  } else {
+    ++run.failed;
+    if (run.failed <= 5) {
+      printf("client %zu: %s\n", index, run.clients[index]->lastError().c_str());
+    }
+  }
+  sendNext(run, index);
+}
+
+int main(int argc, char **argv) {
+  size_t clientCount = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 50;
+  Run run;
+  run.messages = argc > 2 ? atoi(argv[2]) : 20;
+  unsigned long delayMs = argc > 3 ? static_cast<unsigned long>(atol(argv[3])) : 20;
+  bool insecure = argc > 5 && strcmp(argv[5], "insecure") == 0;
+  run.ok = 0;
+  run.failed = 0;
+  run.message = "Sensor gateway: suhu 28.5 C, kelembapan 71 %";
+
+  String baseUrl;
+  static WaavisStandin server;
+  if (argc > 4) {
+    baseUrl = argv[4];
+  } else {
+    if (!standinStart(server, 0, false)) {
+      perror("stand-in");
+      return 1;
+    }
+    standinSetDelay(delayMs);
+    standinServeInBackground(server);
+    baseUrl = "http://127.0.0.1:" + String(static_cast<unsigned int>(server.port));
+  }
+  bool https = baseUrl.startsWith("https://");
+
+  WaavisGateway gateway;
+  gateway.onSendComplete(sendComplete, &run);
+  std::vector<std::unique_ptr<WiFiClient>> transports;
+  for (size_t i = 0; i < clientCount; ++i) {
+    WiFiClient *transport;
+    if (https) {
+      WiFiClientSecure *secure = new WiFiClientSecure();
+      if (insecure) {
+        secure->setInsecure();
+      }
+      transport = secure;
+    } else {
+      transport = new WiFiClient();
+    }
+    transport->setNonBlockingConnect(true);
+    transports.emplace_back(transport);
+    run.clients.emplace_back(new WaavisClient(baseUrl));
+    run.clients.back()->setTransport(transport, true);
+    gateway.add(*run.clients.back(), *transport);
+    run.left.push_back(run.messages);
+  }
+
+  printf("%zu clients x %d messages against %s\n", clientCount, run.messages,
+         baseUrl.c_str());
+  unsigned long start = millis();
+  for (size_t i = 0; i < clientCount; ++i) {
+    sendNext(run, i);
+  }
+  while (gateway.run(1000) > 0) {
+  }
+  unsigned long elapsedMs = millis() - start;
+  printf("%zu sent, %zu failed in %lu ms, %.1f messages/s on one thread\n", run.ok,
+         run.failed, elapsedMs, elapsedMs > 0 ? run.ok * 1000.0 / elapsedMs : 0.0);
+  return run.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+#include "Arduino.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+
+static uint64_t monotonicUs() {
+  static uint64_t origin = 0;
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t us = static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+  if (origin == 0) {
+    origin = us;
+  }
+  return us - origin;
+}
+
+unsigned long millis() {
+  return static_cast<unsigned long>(monotonicUs() / 1000);
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(monotonicUs());
+}
+
+void delay(unsigned long ms) {
+  usleep(ms * 1000);
+}
+
+void yield() {}
+
+long random(long max) {
+  return max > 0 ? ::random() % max : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+// String
+
+String::String(const char *text) : _buf(nullptr), _len(0), _cap(0) {
+  concat(text);
+}
+
+String::String(const char *text, size_t length) : _buf(nullptr), _len(0), _cap(0) {
+  concat(text, static_cast<unsigned int>(length));
+}
+
+String::String(const String &other) : _buf(nullptr), _len(0), _cap(0) {
+  concat(other);
+}
+
+String::String(String &&other) noexcept : _buf(other._buf), _len(other._len), _cap(other._cap) {
+  other._buf = nullptr;
+  other._len = 0;
+  other._cap = 0;
+}
+
+String::String(char c) : _buf(nullptr), _len(0), _cap(0) {
+  concat(c);
+}
+
+static void formatInteger(String &out, unsigned long long magnitude, bool negative,
+                          unsigned char base) {
+  char digits[72];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  if (base < 2 || base > 36) {
+    base = DEC;
+  }
+  do {
+    unsigned digit = static_cast<unsigned>(magnitude % base);
+    *--p = static_cast<char>(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    magnitude /= base;
+  } while (magnitude != 0);
+  if (negative) {
+    *--p = '-';
+  }
+  out.concat(p, static_cast<unsigned int>(end - p));
+}
+
+String::String(int value, unsigned char base) : String(static_cast<long>(value), base) {}
+
+String::String(unsigned int value, unsigned char base)
+    : String(static_cast<unsigned long>(value), base) {}
+
+String::String(long value, unsigned char base) : _buf(nullptr), _len(0), _cap(0) {
+  // Like the ESP cores, only base 10 is signed.
+  if (base == DEC && value < 0) {
+    formatInteger(*this, 0ULL - static_cast<unsigned long long>(value), true, base);
+  } else {
+    formatInteger(*this, static_cast<unsigned long>(value), false, base);
+  }
+}
+
+String::String(unsigned long value, unsigned char base) : _buf(nullptr), _len(0), _cap(0) {
+  formatInteger(*this, value, false, base);
+}
+
+String::String(double value, unsigned int decimals) : _buf(nullptr), _len(0), _cap(0) {
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", static_cast<int>(decimals), value);
+  concat(text);
+}
+
+String::~String() {
+  free(_buf);
+}
+
+String &String::operator=(const String &other) {
+  if (this != &other) {
+    _len = 0;
+    concat(other);
+  }
+  return *this;
+}
+
+String &String::operator=(String &&other) noexcept {
+  if (this != &other) {
+    free(_buf);
+    _buf = other._buf;
+    _len = other._len;
+    _cap = other._cap;
+    other._buf = nullptr;
+    other._len = 0;
+    other._cap = 0;
+  }
+  return *this;
+}
+
+String &String::operator=(const char *text) {
+  _len = 0;
+  concat(text);
+  return *this;
+}
+
+bool String::reserve(unsigned int size) {
+  if (_buf != nullptr && _cap >= size) {
+    return true;
+  }
+  char *grown = static_cast<char *>(realloc(_buf, size + 1));
+  if (grown == nullptr) {
+    return false;
+  }
+  if (_buf == nullptr) {
+    grown[0] = '\0';
+  }
+  _buf = grown;
+  _cap = size;
+  return true;
+}
+
+bool String::concat(const char *text, unsigned int length) {
+  if (text == nullptr) {
+    return false;
+  }
+  if (!reserve(_len + length)) {
+    return false;
+  }
+  // text may point into this string.
+  memmove(_buf + _len, text, length);
+  _len += length;
+  _buf[_len] = '\0';
+  return true;
+}
+
+bool String::equals(const String &other) const {
+  return _len == other._len && memcmp(c_str(), other.c_str(), _len) == 0;
+}
+
+bool String::equals(const char *text) const {
+  return strcmp(c_str(), text != nullptr ? text : "") == 0;
+}
+
+bool String::equalsIgnoreCase(const String &other) const {
+  return _len == other._len && strcasecmp(c_str(), other.c_str()) == 0;
+}
+
+bool String::startsWith(const String &prefix) const {
+  return prefix._len <= _len && memcmp(c_str(), prefix.c_str(), prefix._len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return suffix._len <= _len &&
+         memcmp(c_str() + _len - suffix._len, suffix.c_str(), suffix._len) == 0;
+}
+
+char &String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= _len) {
+    dummy = '\0';
+    return dummy;
+  }
+  return _buf[index];
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  if (from >= _len) {
+    return -1;
+  }
+  const char *found = static_cast<const char *>(memchr(_buf + from, c, _len - from));
+  return found != nullptr ? static_cast<int>(found - _buf) : -1;
+}
+
+int String::indexOf(const String &text, unsigned int from) const {
+  if (from > _len) {
+    return -1;
+  }
+  const char *found = strstr(c_str() + from, text.c_str());
+  return found != nullptr ? static_cast<int>(found - c_str()) : -1;
+}
+
+int String::lastIndexOf(char c) const {
+  for (unsigned int i = _len; i > 0; --i) {
+    if (_buf[i - 1] == c) {
+      return static_cast<int>(i - 1);
+    }
+  }
+  return -1;
+}
+
+int String::lastIndexOf(const String &text) const {
+  if (text._len > _len) {
+    return -1;
+  }
+  for (unsigned int i = _len - text._len + 1; i > 0; --i) {
+    if (memcmp(c_str() + i - 1, text.c_str(), text._len) == 0) {
+      return static_cast<int>(i - 1);
+    }
+  }
+  return -1;
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int swap = from;
+    from = to;
+    to = swap;
+  }
+  if (to > _len) {
+    to = _len;
+  }
+  if (from >= to) {
+    return String();
+  }
+  return String(_buf + from, to - from);
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < _len; ++i) {
+    _buf[i] = static_cast<char>(tolower(static_cast<unsigned char>(_buf[i])));
+  }
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < _len; ++i) {
+    _buf[i] = static_cast<char>(toupper(static_cast<unsigned char>(_buf[i])));
+  }
+}
+
+void String::trim() {
+  if (_len == 0) {
+    return;
+  }
+  unsigned int begin = 0;
+  while (begin < _len && isspace(static_cast<unsigned char>(_buf[begin]))) {
+    ++begin;
+  }
+  unsigned int end = _len;
+  while (end > begin && isspace(static_cast<unsigned char>(_buf[end - 1]))) {
+    --end;
+  }
+  _len = end - begin;
+  memmove(_buf, _buf + begin, _len);
+  _buf[_len] = '\0';
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= _len) {
+    return;
+  }
+  if (count > _len - index) {
+    count = _len - index;
+  }
+  memmove(_buf + index, _buf + index + count, _len - index - count);
+  _len -= count;
+  _buf[_len] = '\0';
+}
+
+String operator+(const String &lhs, const String &rhs) {
+  String out;
+  out.reserve(lhs.length() + rhs.length());
+  out.concat(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+String operator+(const String &lhs, const char *rhs) {
+  return lhs + String(rhs);
+}
+
+String operator+(const char *lhs, const String &rhs) {
+  return String(lhs) + rhs;
+}
+
+String operator+(const String &lhs, char rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+// Print / Stream
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (n < size && write(buffer[n]) == 1) {
+    ++n;
+  }
+  return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+  char small[128];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(small, sizeof(small), format, args);
+  va_end(args);
+  if (len < 0) {
+    return 0;
+  }
+  if (static_cast<size_t>(len) < sizeof(small)) {
+    return write(small, static_cast<size_t>(len));
+  }
+  char *large = static_cast<char *>(malloc(static_cast<size_t>(len) + 1));
+  if (large == nullptr) {
+    return 0;
+  }
+  va_start(args, format);
+  vsnprintf(large, static_cast<size_t>(len) + 1, format, args);
+  va_end(args);
+  size_t n = write(large, static_cast<size_t>(len));
+  free(large);
+  return n;
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) {
+      return c;
+    }
+    delay(1);
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = timedRead();
+    if (c < 0) {
+      break;
+    }
+    buffer[n++] = static_cast<char>(c);
+  }
+  return n;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  return fwrite(buffer, 1, size, stdout);
+}
+
+// IPAddress
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : _address(static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8 |
+               static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24) {}
+
+bool IPAddress::fromString(const char *text) {
+  in_addr parsed;
+  if (inet_pton(AF_INET, text, &parsed) != 1) {
+    return false;
+  }
+  _address = parsed.s_addr;
+  return true;
+}
+
+String IPAddress::toString() const {
+  char text[INET_ADDRSTRLEN];
+  in_addr address;
+  address.s_addr = _address;
+  inet_ntop(AF_INET, &address, text, sizeof(text));
+  return String(text);
+}
@@ -0,0 +1,213 @@
+#ifndef WAAVIS_HOST_ARDUINO_H
+#define WAAVIS_HOST_ARDUINO_H
+
+// Minimal Arduino core for building the library on Linux. Only what the
+// library, its examples' logic and the host programs use is provided; the
+// semantics follow the ESP32 core.
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/types.h>
+
+typedef uint8_t byte;
+
+#define DEC 10
+#define HEX 16
+#define F(text) (text)
+// No RTC memory; state "kept over deep sleep" lives as long as the process.
+#define RTC_DATA_ATTR
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+// [0, max) and [min, max), from the C library's random().
+long random(long max);
+long random(long min, long max);
+
+class String {
+public:
+  String(const char *text = "");
+  String(const char *text, size_t length);
+  String(const String &other);
+  String(String &&other) noexcept;
+  explicit String(char c);
+  explicit String(int value, unsigned char base = DEC);
+  explicit String(unsigned int value, unsigned char base = DEC);
+  explicit String(long value, unsigned char base = DEC);
+  explicit String(unsigned long value, unsigned char base = DEC);
+  explicit String(double value, unsigned int decimals = 2);
+  ~String();
+
+  String &operator=(const String &other);
+  String &operator=(String &&other) noexcept;
+  String &operator=(const char *text);
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return _len; }
+  const char *c_str() const { return _buf != nullptr ? _buf : ""; }
+
+  bool concat(const String &other) { return concat(other.c_str(), other._len); }
+  bool concat(const char *text) { return concat(text, text != nullptr ? strlen(text) : 0); }
+  bool concat(const char *text, unsigned int length);
+  bool concat(char c) { return concat(&c, 1); }
+  bool concat(int value) { return concat(String(value)); }
+  bool concat(unsigned int value) { return concat(String(value)); }
+  bool concat(long value) { return concat(String(value)); }
+  bool concat(unsigned long value) { return concat(String(value)); }
+
+  String &operator+=(const String &other) { concat(other); return *this; }
+  String &operator+=(const char *text) { concat(text); return *this; }
+  String &operator+=(char c) { concat(c); return *this; }
+  String &operator+=(int value) { concat(value); return *this; }
+  String &operator+=(unsigned int value) { concat(value); return *this; }
+  String &operator+=(long value) { concat(value); return *this; }
+  String &operator+=(unsigned long value) { concat(value); return *this; }
+
+  bool equals(const String &other) const;
+  bool equals(const char *text) const;
+  bool equalsIgnoreCase(const String &other) const;
+  bool operator==(const String &other) const { return equals(other); }
+  bool operator==(const char *text) const { return equals(text); }
+  bool operator!=(const String &other) const { return !equals(other); }
+  bool operator!=(const char *text) const { return !equals(text); }
+  bool operator<(const String &other) const { return strcmp(c_str(), other.c_str()) < 0; }
+
+  bool startsWith(const String &prefix) const;
+  bool endsWith(const String &suffix) const;
+  char charAt(unsigned int index) const { return index < _len ? _buf[index] : '\0'; }
+  char operator[](unsigned int index) const { return charAt(index); }
+  char &operator[](unsigned int index);
+
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String &text, unsigned int from = 0) const;
+  int lastIndexOf(char c) const;
+  int lastIndexOf(const String &text) const;
+  String substring(unsigned int from) const { return substring(from, _len); }
+  String substring(unsigned int from, unsigned int to) const;
+
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+  void remove(unsigned int index) { remove(index, _len); }
+  void remove(unsigned int index, unsigned int count);
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return static_cast<float>(atof(c_str())); }
+
+private:
+  char *_buf;
+  unsigned int _len;
+  unsigned int _cap;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *text) { return text != nullptr ? write(text, strlen(text)) : 0; }
+  size_t write(const char *buffer, size_t size) {
+    return write(reinterpret_cast<const uint8_t *>(buffer), size);
+  }
+  // Bytes write() takes without waiting; 0 if unknown.
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const String &text) { return write(text.c_str(), text.length()); }
+  size_t print(const char *text) { return write(text); }
+  size_t print(char c) { return write(static_cast<uint8_t>(c)); }
+  size_t print(int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned int value, int base = DEC) { return print(String(value, base)); }
+  size_t print(long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(unsigned long value, int base = DEC) { return print(String(value, base)); }
+  size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+
+  template <typename T>
+  size_t println(const T &value) {
+    size_t n = print(value);
+    return n + println();
+  }
+  size_t println() { return write("\r\n"); }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeoutMs) { _timeout = timeoutMs; }
+  unsigned long getTimeout() const { return _timeout; }
+  // Waits up to the timeout for each byte, like the ESP32 core.
+  virtual size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length) {
+    return readBytes(reinterpret_cast<char *>(buffer), length);
+  }
+
+protected:
+  int timedRead();
+
+  unsigned long _timeout = 1000;
+};
+
+class IPAddress {
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint32_t address) : _address(address) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+
+  operator uint32_t() const { return _address; }
+  uint8_t operator[](int index) const { return (_address >> (8 * index)) & 0xFF; }
+  bool fromString(const char *text);
+  bool fromString(const String &text) { return fromString(text.c_str()); }
+  String toString() const;
+
+private:
+  // Network byte order, as on the ESP cores.
+  uint32_t _address;
+};
+
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char *host, uint16_t port) = 0;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t *buffer, size_t size) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+  using Print::write;
+};
+
+// Serial goes to stdout.
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
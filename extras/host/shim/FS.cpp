@@ -0,0 +1,89 @@
+#include "FS.h"
+
+#include <sys/stat.h>
+
+namespace fs {
+
+File::File(FILE *file) : _file(file, fclose) {}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  return _file != nullptr ? fwrite(buffer, 1, size, _file.get()) : 0;
+}
+
+int File::available() {
+  size_t at = position();
+  size_t end = size();
+  return end > at ? static_cast<int>(end - at) : 0;
+}
+
+int File::read() {
+  return _file != nullptr ? fgetc(_file.get()) : -1;
+}
+
+int File::peek() {
+  if (_file == nullptr) {
+    return -1;
+  }
+  int c = fgetc(_file.get());
+  if (c != EOF) {
+    ungetc(c, _file.get());
+  }
+  return c;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  return _file != nullptr ? fread(buffer, 1, size, _file.get()) : 0;
+}
+
+bool File::seek(uint32_t position) {
+  return _file != nullptr && fseek(_file.get(), static_cast<long>(position), SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+  long at = _file != nullptr ? ftell(_file.get()) : -1;
+  return at > 0 ? static_cast<size_t>(at) : 0;
+}
+
+size_t File::size() const {
+  if (_file == nullptr) {
+    return 0;
+  }
+  fflush(_file.get());
+  struct stat info;
+  return fstat(fileno(_file.get()), &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+}
+
+void File::close() {
+  _file.reset();
+}
+
+FS::FS(const char *root) : _root(root) {}
+
+String FS::hostPath(const char *path) const {
+  return _root + (path[0] == '/' ? "" : "/") + path;
+}
+
+File FS::open(const char *path, const char *mode) {
+  const char *hostMode = mode[0] == 'w' ? "wb" : mode[0] == 'a' ? "ab" : "rb";
+  FILE *file = fopen(hostPath(path).c_str(), hostMode);
+  return file != nullptr ? File(file) : File();
+}
+
+bool FS::exists(const char *path) {
+  struct stat info;
+  return stat(hostPath(path).c_str(), &info) == 0;
+}
+
+bool FS::remove(const char *path) {
+  return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
+
+}  // namespace fs
@@ -0,0 +1,60 @@
+#ifndef WAAVIS_HOST_FS_H
+#define WAAVIS_HOST_FS_H
+
+#include <Arduino.h>
+
+#include <memory>
+
+namespace fs {
+
+// An open file; copies share it and the last one closes it, as on the ESP
+// cores.
+class File : public Stream {
+public:
+  File() {}
+  explicit File(FILE *file);
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t *buffer, size_t size);
+  bool seek(uint32_t position);
+  size_t position() const;
+  size_t size() const;
+  void close();
+  operator bool() const { return _file != nullptr; }
+
+private:
+  std::shared_ptr<FILE> _file;
+};
+
+// Files under a directory on the host; paths are taken relative to it.
+class FS {
+public:
+  explicit FS(const char *root);
+
+  // mode is "r", "w" or "a".
+  File open(const char *path, const char *mode = "r");
+  File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+
+private:
+  String hostPath(const char *path) const;
+
+  String _root;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
@@ -0,0 +1,244 @@
+#include "WiFi.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+uint8_t *WiFiClass::BSSID() {
+  static uint8_t bssid[6];
+  return bssid;
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &result) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *found = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &found) != 0 || found == nullptr) {
+    return 0;
+  }
+  result = IPAddress(reinterpret_cast<sockaddr_in *>(found->ai_addr)->sin_addr.s_addr);
+  freeaddrinfo(found);
+  return 1;
+}
+
+// What availableForWrite() reports for a writable socket: less than the
+// kernel guarantees free once it signals POLLOUT, so write() never waits.
+static const int kWritableBytes = 2048;
+
+WiFiClient::WiFiClient()
+    : _fd(-1), _nonBlockingConnect(false), _waitEvents(POLLIN), _eof(false), _rxStart(0),
+      _rxEnd(0), _connecting(false) {}
+
+WiFiClient::~WiFiClient() {
+  stop();
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  stop();
+  _fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (_fd < 0) {
+    return 0;
+  }
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = static_cast<uint32_t>(ip);
+  // The library writes the head and the body separately; do not let Nagle
+  // hold the body back for the peer's delayed ACK.
+  int one = 1;
+  setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (::connect(_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+    if (errno != EINPROGRESS) {
+      stop();
+      return 0;
+    }
+    _connecting = true;
+    _waitEvents = POLLOUT;
+    if (!_nonBlockingConnect && (!waitSocket(POLLOUT, _timeout) || !connectStep())) {
+      stop();
+      return 0;
+    }
+  }
+  return 1;
+}
+
+bool WiFiClient::connectStep() {
+  if (!_connecting) {
+    return true;
+  }
+  if (!waitSocket(POLLOUT, 0)) {
+    _waitEvents = POLLOUT;
+    return false;
+  }
+  _connecting = false;
+  int error = 0;
+  socklen_t length = sizeof(error);
+  if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+    _eof = true;
+    return false;
+  }
+  return true;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  IPAddress address;
+  if (!WiFi.hostByName(host, address)) {
+    return 0;
+  }
+  return connect(address, port);
+}
+
+size_t WiFiClient::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+  if (_fd < 0) {
+    return 0;
+  }
+  size_t sent = 0;
+  unsigned long start = millis();
+  while (sent < size && !_eof) {
+    int n = connectStep() ? transportWrite(buffer + sent, size - sent) : 0;
+    if (n < 0) {
+      _eof = true;
+      break;
+    }
+    if (n == 0) {
+      unsigned long waited = millis() - start;
+      if (_eof || waited >= _timeout || !waitSocket(_waitEvents, _timeout - waited)) {
+        break;
+      }
+      continue;
+    }
+    sent += static_cast<size_t>(n);
+  }
+  return sent;
+}
+
+int WiFiClient::availableForWrite() {
+  if (_fd < 0 || _eof || !connectStep()) {
+    return 0;
+  }
+  if (!waitSocket(POLLOUT, 0)) {
+    _waitEvents = POLLOUT;
+    return 0;
+  }
+  return kWritableBytes;
+}
+
+void WiFiClient::fill() {
+  if (_fd < 0 || _eof || !connectStep()) {
+    return;
+  }
+  if (_rxStart == _rxEnd) {
+    _rxStart = 0;
+    _rxEnd = 0;
+  }
+  if (_rxEnd == sizeof(_rx)) {
+    return;
+  }
+  int n = transportRead(_rx + _rxEnd, sizeof(_rx) - _rxEnd);
+  if (n > 0) {
+    _rxEnd += static_cast<size_t>(n);
+  } else if (n < 0) {
+    _eof = true;
+  }
+}
+
+int WiFiClient::available() {
+  fill();
+  return static_cast<int>(_rxEnd - _rxStart);
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+  if (_rxStart == _rxEnd) {
+    fill();
+  }
+  size_t n = _rxEnd - _rxStart;
+  if (n == 0) {
+    return -1;
+  }
+  if (n > size) {
+    n = size;
+  }
+  memcpy(buffer, _rx + _rxStart, n);
+  _rxStart += n;
+  return static_cast<int>(n);
+}
+
+int WiFiClient::peek() {
+  if (_rxStart == _rxEnd) {
+    fill();
+  }
+  return _rxStart < _rxEnd ? _rx[_rxStart] : -1;
+}
+
+void WiFiClient::stop() {
+  if (_fd >= 0) {
+    close(_fd);
+  }
+  _fd = -1;
+  _rxStart = 0;
+  _rxEnd = 0;
+  _eof = false;
+  _connecting = false;
+  _waitEvents = POLLIN;
+}
+
+uint8_t WiFiClient::connected() {
+  if (_fd < 0) {
+    return 0;
+  }
+  if (_rxStart == _rxEnd) {
+    fill();
+  }
+  return _rxStart < _rxEnd || !_eof;
+}
+
+int WiFiClient::transportRead(uint8_t *buffer, size_t size) {
+  ssize_t n = recv(_fd, buffer, size, 0);
+  if (n > 0) {
+    return static_cast<int>(n);
+  }
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+    _waitEvents = POLLIN;
+    return 0;
+  }
+  return -1;
+}
+
+int WiFiClient::transportWrite(const uint8_t *buffer, size_t size) {
+  ssize_t n = send(_fd, buffer, size, MSG_NOSIGNAL);
+  if (n >= 0) {
+    return static_cast<int>(n);
+  }
+  if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+    _waitEvents = POLLOUT;
+    return 0;
+  }
+  return -1;
+}
+
+bool WiFiClient::waitSocket(short events, unsigned long timeoutMs) {
+  pollfd entry;
+  entry.fd = _fd;
+  entry.events = events;
+  entry.revents = 0;
+  return poll(&entry, 1, static_cast<int>(timeoutMs)) > 0;
+}
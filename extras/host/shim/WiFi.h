@@ -0,0 +1,104 @@
+#ifndef WAAVIS_HOST_WIFI_H
+#define WAAVIS_HOST_WIFI_H
+
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum { WIFI_OFF, WIFI_STA } wifi_mode_t;
+
+// The host's network is always up; the station calls only succeed.
+class WiFiClass {
+public:
+  wl_status_t begin(const char *, const char * = nullptr, int32_t = 0,
+                    const uint8_t * = nullptr, bool = true) {
+    return WL_CONNECTED;
+  }
+  wl_status_t status() { return WL_CONNECTED; }
+  bool mode(wifi_mode_t) { return true; }
+  void persistent(bool) {}
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(),
+              IPAddress = IPAddress()) {
+    return true;
+  }
+  bool disconnect(bool = false) { return true; }
+  uint8_t *BSSID();
+  int32_t channel() { return 0; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress gatewayIP() { return IPAddress(); }
+  IPAddress subnetMask() { return IPAddress(255, 0, 0, 0); }
+  IPAddress dnsIP() { return IPAddress(); }
+  // IPv4 lookup through the system resolver.
+  int hostByName(const char *host, IPAddress &result);
+};
+
+extern WiFiClass WiFi;
+
+// TCP client over a non-blocking POSIX socket. Calls wait for at most the
+// Stream timeout: connect() for the connection, write() until the data is
+// handed to the kernel. read() and available() never wait. With
+// setNonBlockingConnect(true), connect() returns once the connection is
+// started; availableForWrite() then stays 0 until it is up, and a failed
+// connect shows as connected() turning false.
+class WiFiClient : public Client {
+public:
+  WiFiClient();
+  ~WiFiClient() override;
+  WiFiClient(const WiFiClient &) = delete;
+  WiFiClient &operator=(const WiFiClient &) = delete;
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buffer, size_t size) override;
+  int peek() override;
+  int availableForWrite() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected() != 0; }
+  using Print::write;
+
+  void setNonBlockingConnect(bool nonBlocking) { _nonBlockingConnect = nonBlocking; }
+  // Socket descriptor, -1 when closed.
+  int fd() const { return _fd; }
+  // What the last call that could not go on waits for: POLLIN or POLLOUT.
+  short waitEvents() const { return _waitEvents; }
+
+protected:
+  // Moves bytes between the socket and the caller: the count, 0 when the
+  // call would block, -1 on close or error.
+  virtual int transportRead(uint8_t *buffer, size_t size);
+  virtual int transportWrite(const uint8_t *buffer, size_t size);
+  // Moves a connect started without waiting on; true once the connection
+  // is up. Sets _waitEvents while it is not, and _eof if it failed.
+  virtual bool connectStep();
+  // Waits until the socket is readable (events POLLIN) or writable
+  // (POLLOUT), at most timeoutMs.
+  bool waitSocket(short events, unsigned long timeoutMs);
+
+  int _fd;
+  bool _nonBlockingConnect;
+  short _waitEvents;
+  bool _eof;
+
+private:
+  // Reads what the socket has without waiting.
+  void fill();
+
+  uint8_t _rx[2048];
+  size_t _rxStart;
+  size_t _rxEnd;
+  bool _connecting;
+};
+
+#endif
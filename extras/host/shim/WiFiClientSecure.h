@@ -0,0 +1,58 @@
+#ifndef WAAVIS_HOST_WIFI_CLIENT_SECURE_H
+#define WAAVIS_HOST_WIFI_CLIENT_SECURE_H
+
+#include <WiFi.h>
+
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+
+// TLS client over the non-blocking socket of WiFiClient, with OpenSSL in
+// place of the ESP32's mbedTLS and the same calls the library uses. The
+// handshake waits for at most the handshake timeout; reads and writes wait
+// like WiFiClient's. With setNonBlockingConnect(true) the handshake is not
+// waited for either: it moves on whenever the client is used, and
+// availableForWrite() stays 0 until it is done; its timeout is then the
+// caller's. Without setCACert() or setInsecure() the server is checked
+// against the system's CA store.
+class WiFiClientSecure : public WiFiClient {
+public:
+  WiFiClientSecure();
+  ~WiFiClientSecure() override;
+
+  void setInsecure();
+  // PEM, one or more certificates; must outlive the client.
+  void setCACert(const char *rootCA);
+  void setHandshakeTimeout(unsigned long handshakeTimeoutSeconds);
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  // Connects to ip and sends host for SNI and the name check. cert and
+  // privateKey (client certificates) are not supported and must be nullptr.
+  int connect(IPAddress ip, uint16_t port, const char *host, const char *rootCA,
+              const char *cert, const char *privateKey);
+  void stop() override;
+
+  // Compares the SHA-256 of the server certificate with fingerprint (hex,
+  // ":" or " " between bytes allowed) and, unless domainName is nullptr,
+  // checks that the certificate is for domainName.
+  bool verify(const char *fingerprint, const char *domainName);
+
+protected:
+  int transportRead(uint8_t *buffer, size_t size) override;
+  int transportWrite(const uint8_t *buffer, size_t size) override;
+  bool connectStep() override;
+
+private:
+  bool beginTls(const char *host, const char *rootCA);
+  // SSL_ERROR_WANT_* to what the socket must become; -1 for other errors.
+  int wantEvents(int result);
+
+  SSL_CTX *_ctx;
+  SSL *_ssl;
+  const char *_caCert;
+  bool _insecure;
+  bool _handshaking;
+  unsigned long _handshakeTimeoutMs;
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "standin.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+static const size_t kKeptBodySize = 65536;
+
+static std::atomic<uint64_t> requestCount(0);
+static std::atomic<uint64_t> bodyByteCount(0);
+static std::atomic<unsigned long> responseDelayMs(0);
+static std::atomic<unsigned long> idleCloseMs(0);
+static std::atomic<unsigned long> idleDropMs(0);
+static std::atomic<bool> chunkedResponses(false);
+static std::mutex fixedLock;
+static int fixedStatus = 200;
+static std::string fixedBody;
+static bool fixedResponse = false;
+static std::string lastBody;
+
+namespace {
+
+class Connection {
+public:
+  explicit Connection(int fd) : _fd(fd), _start(0), _end(0) {}
+
+  void setReadTimeout(unsigned long timeoutMs) {
+    timeval timeout = {static_cast<time_t>(timeoutMs / 1000),
+                       static_cast<suseconds_t>(timeoutMs % 1000 * 1000)};
+    setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  }
+
+  // One line without its CRLF; false once the peer is gone.
+  bool readLine(std::string &line) {
+    line.clear();
+    while (true) {
+      if (_start == _end && !fill()) {
+        return false;
+      }
+      char c = _buffer[_start++];
+      if (c == '\n') {
+        if (!line.empty() && line.back() == '\r') {
+          line.pop_back();
+        }
+        return true;
+      }
+      line += c;
+    }
+  }
+
+  // Reads length body bytes, appending them to kept up to kKeptBodySize.
+  bool skip(size_t length, std::string &kept) {
+    while (length > 0) {
+      if (_start == _end && !fill()) {
+        return false;
+      }
+      size_t n = _end - _start < length ? _end - _start : length;
+      if (kept.size() < kKeptBodySize) {
+        kept.append(_buffer + _start, std::min(n, kKeptBodySize - kept.size()));
+      }
+      _start += n;
+      length -= n;
+      bodyByteCount += n;
+    }
+    return true;
+  }
+
+  bool send(const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n = ::send(_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) {
+        return false;
+      }
+      sent += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+private:
+  bool fill() {
+    ssize_t n = recv(_fd, _buffer, sizeof(_buffer), 0);
+    if (n <= 0) {
+      return false;
+    }
+    _start = 0;
+    _end = static_cast<size_t>(n);
+    return true;
+  }
+
+  int _fd;
+  char _buffer[16384];
+  size_t _start;
+  size_t _end;
+};
+
+bool headerIs(const std::string &line, const char *name, std::string &value) {
+  size_t length = strlen(name);
+  if (line.size() <= length || strncasecmp(line.c_str(), name, length) != 0 ||
+      line[length] != ':') {
+    return false;
+  }
+  size_t begin = line.find_first_not_of(" \t", length + 1);
+  value = begin == std::string::npos ? std::string() : line.substr(begin);
+  return true;
+}
+
+unsigned long nowMs() {
+  return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Serves one request; false when the connection should be dropped.
+// answeredAt is when the previous response went out, 0 before the first.
+bool serveRequest(Connection &connection, uint64_t &messageId, unsigned long &answeredAt) {
+  std::string line;
+  // Idle kept-alive connections are dropped like a real server would.
+  connection.setReadTimeout(idleCloseMs > 0 ? idleCloseMs.load() : 30000);
+  if (!connection.readLine(line) || line.empty()) {
+    return false;
+  }
+  connection.setReadTimeout(30000);
+  if (idleDropMs > 0 && answeredAt != 0 && nowMs() - answeredAt > idleDropMs) {
+    return false;
+  }
+  size_t space = line.find(' ');
+  std::string path = line.substr(space + 1, line.find(' ', space + 1) - space - 1);
+
+  size_t contentLength = 0;
+  bool chunked = false;
+  bool close = false;
+  std::string value;
+  while (true) {
+    if (!connection.readLine(line)) {
+      return false;
+    }
+    if (line.empty()) {
+      break;
+    }
+    if (headerIs(line, "Content-Length", value)) {
+      contentLength = strtoul(value.c_str(), nullptr, 10);
+    } else if (headerIs(line, "Transfer-Encoding", value)) {
+      chunked = strncasecmp(value.c_str(), "chunked", 7) == 0;
+    } else if (headerIs(line, "Connection", value)) {
+      close = strncasecmp(value.c_str(), "close", 5) == 0;
+    }
+  }
+
+  std::string kept;
+  if (chunked) {
+    while (true) {
+      if (!connection.readLine(line)) {
+        return false;
+      }
+      size_t size = strtoul(line.c_str(), nullptr, 16);
+      if (size == 0) {
+        // Trailers end with an empty line.
+        while (connection.readLine(line) && !line.empty()) {
+        }
+        break;
+      }
+      if (!connection.skip(size, kept) || !connection.readLine(line)) {
+        return false;
+      }
+    }
+  } else if (!connection.skip(contentLength, kept)) {
+    return false;
+  }
+
+  std::string body;
+  std::string status = "200 OK";
+  if (path.compare(0, 13, "/v1/send_chat") == 0) {
+    std::lock_guard<std::mutex> guard(fixedLock);
+    lastBody.swap(kept);
+    if (fixedResponse) {
+      status = std::to_string(fixedStatus) + (fixedStatus == 200 ? " OK" : " Error");
+      body = fixedBody;
+    } else {
+      body = "{\"status\":true,\"message_id\":\"bench-" + std::to_string(++messageId) + "\"}";
+    }
+  } else {
+    status = "404 Not Found";
+    body = "{\"status\":false,\"error\":\"not found\"}";
+  }
+  ++requestCount;
+  if (responseDelayMs > 0) {
+    usleep(static_cast<useconds_t>(responseDelayMs * 1000));
+  }
+  std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\n";
+  if (chunkedResponses) {
+    size_t half = body.size() / 2;
+    char size[24];
+    response += "Transfer-Encoding: chunked";
+    response += close ? "\r\nConnection: close\r\n\r\n" : "\r\nConnection: keep-alive\r\n\r\n";
+    snprintf(size, sizeof(size), "%zx\r\n", half);
+    response += size + body.substr(0, half) + "\r\n";
+    snprintf(size, sizeof(size), "%zx\r\n", body.size() - half);
+    response += size + body.substr(half) + "\r\n0\r\n\r\n";
+  } else {
+    response += "Content-Length: " + std::to_string(body.size()) +
+                (close ? "\r\nConnection: close" : "\r\nConnection: keep-alive") +
+                "\r\n\r\n" + body;
+  }
+  bool sent = connection.send(response);
+  answeredAt = nowMs();
+  return sent && !close;
+}
+
+void serveConnection(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  Connection connection(fd);
+  uint64_t messageId = 0;
+  unsigned long answeredAt = 0;
+  while (serveRequest(connection, messageId, answeredAt)) {
+  }
+  close(fd);
+}
+
+}  // namespace
+
+bool standinStart(WaavisStandin &server, uint16_t port, bool anyInterface) {
+  server.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (server.listenFd < 0) {
+    return false;
+  }
+  int one = 1;
+  setsockopt(server.listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(anyInterface ? INADDR_ANY : INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (bind(server.listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+      listen(server.listenFd, SOMAXCONN) != 0 ||
+      getsockname(server.listenFd, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+    close(server.listenFd);
+    server.listenFd = -1;
+    return false;
+  }
+  server.port = ntohs(address.sin_port);
+  return true;
+}
+
+void standinServe(WaavisStandin &server) {
+  while (true) {
+    int fd = accept4(server.listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    std::thread(serveConnection, fd).detach();
+  }
+}
+
+void standinServeInBackground(WaavisStandin &server) {
+  std::thread(standinServe, std::ref(server)).detach();
+}
+
+void standinSetDelay(unsigned long delayMs) {
+  responseDelayMs = delayMs;
+}
+
+void standinSetIdleClose(unsigned long idleMs) {
+  idleCloseMs = idleMs;
+}
+
+void standinSetIdleDrop(unsigned long idleMs) {
+  idleDropMs = idleMs;
+}
+
+void standinSetChunked(bool chunked) {
+  chunkedResponses = chunked;
+}
+
+void standinSetResponse(int status, const char *body) {
+  std::lock_guard<std::mutex> guard(fixedLock);
+  fixedResponse = body != nullptr;
+  fixedStatus = status;
+  fixedBody = body != nullptr ? body : "";
+}
+
+uint64_t standinRequests() {
+  return requestCount;
+}
+
+uint64_t standinBodyBytes() {
+  return bodyByteCount;
+}
+
+std::string standinLastBody() {
+  std::lock_guard<std::mutex> guard(fixedLock);
+  return lastBody;
+}
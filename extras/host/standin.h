@@ -0,0 +1,46 @@
+#ifndef WAAVIS_HOST_STANDIN_H
+#define WAAVIS_HOST_STANDIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Stand-in for api.waavis.com: answers send_chat, send_chat_link and
+// send_chat_media over plain HTTP/1.1 keep-alive, one thread per connection.
+// Bodies are read and counted; only the start of the last one is kept.
+struct WaavisStandin {
+  int listenFd;
+  uint16_t port;
+};
+
+// Listens on port (0 picks a free one) on loopback, or on every interface
+// with anyInterface. Returns false if the socket cannot be bound.
+bool standinStart(WaavisStandin &server, uint16_t port, bool anyInterface);
+// Accepts connections on a background thread.
+void standinServeInBackground(WaavisStandin &server);
+// Accepts connections on the calling thread; does not return.
+void standinServe(WaavisStandin &server);
+
+// Delays every response by delayMs (default 0), like the real API's
+// processing time.
+void standinSetDelay(unsigned long delayMs);
+// Fault: connections idle for idleMs are closed (default 30 s; 0 restores
+// it), like the real API does with kept-alive sockets.
+void standinSetIdleClose(unsigned long idleMs);
+// Fault: a request that arrives on a connection idle for more than idleMs
+// is dropped unanswered together with the connection, as when the server's
+// idle close crosses the request on the wire. 0 (the default) turns it off.
+void standinSetIdleDrop(unsigned long idleMs);
+// Sends the responses with chunked transfer encoding, in two chunks.
+void standinSetChunked(bool chunked);
+// Answers the send_chat* paths with this status and body instead of a
+// success with a fresh message id; a nullptr body goes back to that.
+void standinSetResponse(int status, const char *body);
+
+uint64_t standinRequests();
+uint64_t standinBodyBytes();
+// The first 64 KB of the last request body.
+std::string standinLastBody();
+
+#endif
@@ -0,0 +1,21 @@
+// Stand-in server for examples/waavis_benchmark. Run it on a computer in the
+// same network as the ESP32, so the device only runs the client under test:
+//
+//   ./waavis_standin [port]
+
+#include "standin.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char **argv) {
+  uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 8080);
+  WaavisStandin server;
+  if (!standinStart(server, port, true)) {
+    perror("waavis_standin");
+    return 1;
+  }
+  printf("Stand-in listening on port %u\n", server.port);
+  fflush(stdout);
+  standinServe(server);
+}
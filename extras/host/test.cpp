@@ -0,0 +1,340 @@
+// Regression tests of WaavisClient on Linux against the loopback stand-in
+// server, including its fault modes. Run with "make test"; the exit status
+// is the number of failed checks.
+
+#include <Waavis.h>
+#include <WaavisForm.h>
+#include <WaavisTemplate.h>
+#include <FS.h>
+#include <WiFiClientSecure.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gateway.h"
+#include "standin.h"
+
+static int failures = 0;
+
+#define CHECK(condition)                                                    \
+  do {                                                                      \
+    if (!(condition)) {                                                     \
+      ++failures;                                                           \
+      printf("  FAILED line %d: %s\n", __LINE__, #condition);               \
+    }                                                                       \
+  } while (0)
+
+// A file in memory for the media sends.
+class MemoryStream : public Stream {
+public:
+  MemoryStream(const uint8_t *data, size_t size) : _data(data), _size(size), _at(0) {}
+
+  int available() override { return static_cast<int>(_size - _at); }
+  int read() override { return _at < _size ? _data[_at++] : -1; }
+  int peek() override { return _at < _size ? _data[_at] : -1; }
+  size_t readBytes(char *buffer, size_t length) override {
+    size_t n = _size - _at < length ? _size - _at : length;
+    memcpy(buffer, _data + _at, n);
+    _at += n;
+    return n;
+  }
+  size_t write(uint8_t) override { return 0; }
+
+private:
+  const uint8_t *_data;
+  size_t _size;
+  size_t _at;
+};
+
+static String baseUrl;
+
+static void resetStandin() {
+  standinSetDelay(0);
+  standinSetIdleClose(0);
+  standinSetIdleDrop(0);
+  standinSetChunked(false);
+  standinSetResponse(200, nullptr);
+}
+
+static bool bodyHas(const char *text) {
+  return standinLastBody().find(text) != std::string::npos;
+}
+
+static void testFormEncoding() {
+  String encoded;
+  WaavisForm::encodeValue("a b&c=d/\xC3\xA9~_.-", encoded);
+  CHECK(encoded == "a%20b%26c%3Dd%2F%C3%A9~_.-");
+
+  WaavisClient waavis(baseUrl);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "Suhu 28.5 C & lembap", true));
+  CHECK(bodyHas("to=628123&message=Suhu%2028.5%20C%20%26%20lembap&typing=true"));
+}
+
+static void testTemplate() {
+  static const WaavisTemplate alert("Tank {id} level {pct}% at {time} {{ok}");
+  CHECK(alert.fieldCount() == 3);
+
+  WaavisClient waavis(baseUrl);
+  CHECK(waavis.sendChatTemplate("TOKEN", "628123", alert, {7, WaavisValue(45.26, 1), "12:00"}));
+  CHECK(bodyHas("message=Tank%207%20level%2045.3%25%20at%2012%3A00%20%7Bok%7D"));
+  CHECK(waavis.sendChatTemplate("TOKEN", "628123", alert, {-3L, 0.0, ""}));
+  CHECK(bodyHas("message=Tank%20-3%20level%200.0%25%20at%20%20%7Bok%7D"));
+}
+
+static void testJsonScanner() {
+  WaavisClient waavis(baseUrl);
+  standinSetResponse(400, "{\"status\":false,\"error\":\"nomor \\\"to\\\" salah\","
+                          "\"error_code\":\"bad_to\"}");
+  CHECK(!waavis.sendChatPost("TOKEN", "628123", "halo"));
+  CHECK(waavis.lastResponse().status == 400);
+  CHECK(strcmp(waavis.lastResponse().error, "nomor \"to\" salah") == 0);
+  CHECK(strcmp(waavis.lastResponse().errorCode, "bad_to") == 0);
+  CHECK(waavis.lastError() == "nomor \"to\" salah");
+
+  // Fields longer than their buffers are cut, and a body far larger than
+  // any buffer is still read through, keeping the connection usable.
+  std::string big = "{\"status\":true,\"padding\":\"" + std::string(20000, 'x') +
+                    "\",\"message_id\":\"" + std::string(100, 'm') + "\"}";
+  standinSetResponse(200, big.c_str());
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "halo"));
+  CHECK(strlen(waavis.lastResponse().messageId) == sizeof(waavis.lastResponse().messageId) - 1);
+  resetStandin();
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "halo"));
+  CHECK(waavis.lastTiming().reused);
+  CHECK(strncmp(waavis.lastResponse().messageId, "bench-", 6) == 0);
+}
+
+static void testChunkedResponse() {
+  WaavisClient waavis(baseUrl);
+  standinSetChunked(true);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "halo"));
+  CHECK(strcmp(waavis.lastResponse().messageId, "bench-1") == 0);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "halo"));
+  CHECK(waavis.lastTiming().reused);
+  CHECK(strcmp(waavis.lastResponse().messageId, "bench-2") == 0);
+  resetStandin();
+}
+
+// user-001: a kept-alive connection the server dropped as the request
+// arrived is replaced once, and the request reaches the server once; one
+// the server closed while idle is replaced before anything is sent.
+static void testStaleKeepAlive() {
+  WaavisClient waavis(baseUrl);
+  standinSetIdleDrop(50);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "satu"));
+  uint64_t requests = standinRequests();
+  delay(120);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "dua"));
+  CHECK(!waavis.lastTiming().reused);
+  CHECK(standinRequests() == requests + 1);
+  CHECK(bodyHas("message=dua"));
+  standinSetIdleDrop(0);
+
+  static uint8_t file[3000];
+  for (size_t i = 0; i < sizeof(file); ++i) {
+    file[i] = static_cast<uint8_t>('a' + i % 26);
+  }
+  standinSetIdleClose(50);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "tiga"));
+  delay(120);
+  MemoryStream stream(file, sizeof(file));
+  CHECK(waavis.sendChatMedia("TOKEN", "628123", "foto", false, "document", stream,
+                             sizeof(file), "data.txt"));
+  CHECK(!waavis.lastTiming().reused);
+  CHECK(standinRequests() == requests + 3);
+  CHECK(bodyHas(std::string(reinterpret_cast<char *>(file), sizeof(file)).c_str()));
+  resetStandin();
+}
+
+// A response later than the deadline fails the call with the phase named;
+// the next call starts over on a new connection.
+static void testDelayedResponse() {
+  WaavisClient waavis(baseUrl);
+  waavis.setDeadline(100);
+  standinSetDelay(300);
+  unsigned long start = millis();
+  CHECK(!waavis.sendChatPost("TOKEN", "628123", "lambat"));
+  CHECK(millis() - start < 250);
+  CHECK(waavis.lastError() == "Response timeout");
+  resetStandin();
+  delay(300);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "cepat"));
+  CHECK(!waavis.lastTiming().reused);
+}
+
+// user-025: a step send runs through poll() to the same result as the
+// blocking call. Until it ends, the blocking sends fail instead of writing
+// into its request, and processOutbox() leaves the connection alone.
+static void testStepSend() {
+  WaavisClient waavis(baseUrl);
+  uint64_t requests = standinRequests();
+  CHECK(waavis.beginChatPost("TOKEN", "628123", "bertahap"));
+  CHECK(waavis.sendInProgress());
+  CHECK(!waavis.sendChatPost("TOKEN", "628123", "sela"));
+  CHECK(waavis.lastError() == "Send in progress");
+  String recipients[] = {"628123", "628124"};
+  CHECK(waavis.sendChatBatch("TOKEN", recipients, 2, "sela") == 0);
+  CHECK(waavis.lastError() == "Send in progress");
+  static const uint8_t file[] = "isi";
+  CHECK(!waavis.sendChatMediaBuffer("TOKEN", "628123", "sela", false, "document", file,
+                                    sizeof(file), "a.txt"));
+  CHECK(waavis.lastError() == "Send in progress");
+  MemoryStream stream(file, sizeof(file));
+  CHECK(!waavis.sendChatMedia("TOKEN", "628123", "sela", false, "document", stream,
+                              sizeof(file), "a.txt"));
+  CHECK(waavis.lastError() == "Send in progress");
+  CHECK(!waavis.sendChatMediaFromUrl("TOKEN", "628123", "sela", false, "document",
+                                     baseUrl + "/a.jpg"));
+  CHECK(waavis.lastError() == "Send in progress");
+  WaavisPollResult result;
+  unsigned long start = millis();
+  while ((result = waavis.poll(5)) == WaavisPollResult::InProgress && millis() - start < 2000) {
+  }
+  CHECK(result == WaavisPollResult::Done);
+  CHECK(!waavis.sendInProgress());
+  CHECK(strncmp(waavis.lastResponse().messageId, "bench-", 6) == 0);
+  CHECK(bodyHas("message=bertahap"));
+  CHECK(standinRequests() == requests + 1);
+  CHECK(waavis.sendChatPost("TOKEN", "628123", "sesudah"));
+}
+
+struct GatewayRun {
+  bool done[2];
+  bool ok[2];
+  unsigned long at[2];
+};
+
+static void gatewayComplete(size_t index, bool ok, void *arg) {
+  GatewayRun &run = *static_cast<GatewayRun *>(arg);
+  run.done[index] = true;
+  run.ok[index] = ok;
+  run.at[index] = millis();
+}
+
+// user-022: with non-blocking transports, a TLS handshake the server never
+// answers does not hold up another send on the same thread.
+static void testNonBlockingGateway() {
+  // Accepted by the kernel's backlog, never read from.
+  int silent = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (silent < 0 || bind(silent, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+      listen(silent, 4) != 0 ||
+      getsockname(silent, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+    CHECK(false);
+    return;
+  }
+  String silentUrl = "https://127.0.0.1:" + String(static_cast<unsigned int>(ntohs(address.sin_port)));
+
+  WiFiClientSecure stuckTransport;
+  stuckTransport.setInsecure();
+  stuckTransport.setNonBlockingConnect(true);
+  WaavisClient stuck(silentUrl);
+  stuck.setTransport(&stuckTransport, true);
+  stuck.setDeadline(300);
+  WiFiClient plainTransport;
+  plainTransport.setNonBlockingConnect(true);
+  WaavisClient plain(baseUrl);
+  plain.setTransport(&plainTransport, true);
+
+  WaavisGateway gateway;
+  GatewayRun run = {{false, false}, {false, false}, {0, 0}};
+  gateway.onSendComplete(gatewayComplete, &run);
+  gateway.add(stuck, stuckTransport);
+  gateway.add(plain, plainTransport);
+  unsigned long start = millis();
+  CHECK(stuck.beginChatPost("TOKEN", "628123", "macet"));
+  CHECK(plain.beginChatPost("TOKEN", "628123", "lancar"));
+  while (gateway.run(1000) > 0 && millis() - start < 3000) {
+  }
+  CHECK(run.done[1] && run.ok[1]);
+  CHECK(run.at[1] - start < 100);
+  CHECK(run.done[0] && !run.ok[0]);
+  CHECK(run.at[0] - start >= 300);
+  CHECK(stuck.lastError() == "Connect timeout");
+  close(silent);
+}
+
+// user-004: sends that cannot connect are journaled, survive a restart and
+// are delivered once the server is reachable. A send the deadline cut off
+// after it reached the server is not journaled.
+static void testOutbox() {
+  char root[] = "/tmp/waavis_test_XXXXXX";
+  if (mkdtemp(root) == nullptr) {
+    CHECK(false);
+    return;
+  }
+  FS fs(root);
+  {
+    WaavisClient offline("http://127.0.0.1:1");
+    CHECK(offline.beginOutbox(fs));
+    CHECK(offline.sendChatPost("TOKEN", "628123", "antre 1"));
+    CHECK(offline.sendChatPost("TOKEN", "628123", "antre 2"));
+    CHECK(offline.outboxPending() == 2);
+    offline.flushOutbox();
+  }
+
+  WaavisClient waavis(baseUrl);
+  CHECK(waavis.beginOutbox(fs));
+  CHECK(waavis.outboxPending() == 2);
+  CHECK(waavis.beginChatPost("TOKEN", "628123", "bertahap"));
+  waavis.processOutbox();
+  CHECK(waavis.outboxPending() == 2);
+  unsigned long start = millis();
+  while (waavis.poll(5) == WaavisPollResult::InProgress && millis() - start < 2000) {
+  }
+  uint64_t requests = standinRequests();
+  start = millis();
+  while (waavis.outboxPending() > 0 && millis() - start < 5000) {
+    waavis.processOutbox();
+    delay(10);
+  }
+  CHECK(waavis.outboxPending() == 0);
+  CHECK(standinRequests() == requests + 2);
+  CHECK(bodyHas("message=antre%202"));
+
+  waavis.setDeadline(100);
+  standinSetDelay(300);
+  CHECK(!waavis.sendChatPost("TOKEN", "628123", "terlambat"));
+  CHECK(waavis.outboxPending() == 0);
+  resetStandin();
+
+  fs.remove("/waavis_outbox.log");
+  rmdir(root);
+}
+
+int main() {
+  static WaavisStandin server;
+  if (!standinStart(server, 0, false)) {
+    perror("stand-in");
+    return 1;
+  }
+  standinServeInBackground(server);
+  baseUrl = "http://127.0.0.1:" + String(static_cast<unsigned int>(server.port));
+
+  struct {
+    const char *name;
+    void (*run)();
+  } tests[] = {
+      {"form encoding", testFormEncoding},
+      {"template", testTemplate},
+      {"JSON scanner", testJsonScanner},
+      {"chunked response", testChunkedResponse},
+      {"stale keep-alive", testStaleKeepAlive},
+      {"delayed response", testDelayedResponse},
+      {"step send", testStepSend},
+      {"non-blocking gateway", testNonBlockingGateway},
+      {"outbox", testOutbox},
+  };
+  for (const auto &test : tests) {
+    int before = failures;
+    test.run();
+    printf("%-22s %s\n", test.name, failures == before ? "ok" : "FAILED");
+  }
+  return failures;
+}
@@ -0,0 +1,36 @@
+// Sketch for platformio.ini: joins WiFi and sends one text message.
+// WAAVIS_SIZE_SKETCH=0 leaves the library out to measure the core alone.
+
+#include <Arduino.h>
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#else
+#include <WiFi.h>
+#endif
+
+#if WAAVIS_SIZE_SKETCH
+#include <Waavis.h>
+
+#if WAAVIS_ENABLE_TLS
+WaavisClient waavis("https://api.waavis.com");
+#else
+WaavisClient waavis("http://api.waavis.com");
+#endif
+#endif
+
+void setup() {
+  Serial.begin(115200);
+  WiFi.begin("YOUR_WIFI_SSID", "YOUR_WIFI_PASSWORD");
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+  }
+#if WAAVIS_SIZE_SKETCH
+  if (!waavis.sendChatPost("YOUR_TOKEN", "628123456789", "Halo")) {
+    Serial.println(waavis.lastError());
+  }
+#endif
+}
+
+void loop() {
+}
@@ -1,165 +1,1254 @@
-#include "Waavis.h"
+#include "WaavisInternal.h"
+#include "WaavisForm.h"
+#include "WaavisJson.h"
 
-#ifndef WAAVIS_DEBUG
-#define WAAVIS_DEBUG 1
+#if defined(ESP32) && WAAVIS_ENABLE_MEDIA
+#include <esp_heap_caps.h>
 #endif
+#if defined(ESP32) && WAAVIS_ENABLE_SPIFFS_LIST
+#include <HardwareSerial.h>
+#include <SPIFFS.h>
+#include <FS.h>
+#endif
+
+static const unsigned long kDefaultIdleTimeoutMs = 15000;
+static const unsigned long kDefaultStreamIdleTimeoutMs = 5000;
+
+String waavisParseHost(const String &url, bool &isHttps, uint16_t &port,
+                       String &path) {
+  String lower = url;
+  lower.toLowerCase();
+  isHttps = lower.startsWith("https://");
+  bool isHttp = lower.startsWith("http://");
+  if (!isHttps && !isHttp) {
+    return "";
+  }
+
+  int start = isHttps ? 8 : 7;
+  int slash = url.indexOf('/', start);
+  String hostPort = (slash >= 0) ? url.substring(start, slash) : url.substring(start);
+  path = (slash >= 0) ? url.substring(slash) : "";
+  while (path.endsWith("/")) {
+    path.remove(path.length() - 1);
+  }
+  int colon = hostPort.indexOf(':');
+  if (colon >= 0) {
+    port = static_cast<uint16_t>(hostPort.substring(colon + 1).toInt());
+    return hostPort.substring(0, colon);
+  }
 
-#if WAAVIS_DEBUG
-#define WAAVIS_LOG(message) Serial.println(message)
+  port = isHttps ? 443 : 80;
+  return hostPort;
+}
+
+WaavisClient::WaavisClient(const String &baseUrl)
+    : _baseUrl(baseUrl), _insecure(true), _sslCert(nullptr), _lastError(""),
+      _port(0), _https(false), _keepAlive(true),
+      _idleTimeout(kDefaultIdleTimeoutMs), _lastActivity(0), _closedUnanswered(false),
+      _requestStarted(false), _deadline(0),
+      _deadlineStart(0), _holdDeadline(false),
+      _tlsSessionHits(0), _tlsSessionMisses(0), _pipelineDepth(1)
+#if WAAVIS_ENABLE_MEDIA
+      , _streamIdleTimeout(kDefaultStreamIdleTimeoutMs),
+      _progressCallback(nullptr), _progressArg(nullptr), _uploadSent(0),
+      _uploadTotal(0), _uploadStart(0), _uploadCancelled(false),
+      _uplinkBandwidth(0)
+#endif
+#if WAAVIS_ENABLE_OUTBOX
+      , _outboxFs(nullptr), _outboxStage(nullptr), _outboxStageLen(0),
+      _outboxStagedAt(0), _outboxNextId(1), _outboxDeliveredId(0),
+      _outboxPending(0), _outboxAcked(0), _outboxReadPos(0),
+      _outboxNextAttempt(0), _outboxBackoff(0)
+#endif
+#if defined(ESP32)
+      , _asyncJobs(nullptr), _asyncJobCount(0), _nextTicket(1),
+      _asyncHigh(nullptr), _asyncNormal(nullptr), _asyncPending(nullptr),
+      _asyncLock(nullptr), _ioLock(nullptr), _asyncExited(nullptr), _asyncStop(false),
+      _asyncTask(nullptr),
+      _asyncCallback(nullptr), _asyncCallbackArg(nullptr)
+#endif
+{
+  _host = waavisParseHost(_baseUrl, _https, _port, _basePath);
+  memset(&_lastResponse, 0, sizeof(_lastResponse));
+  _lastResponse.status = -1;
+  memset(&_lastTiming, 0, sizeof(_lastTiming));
+  _timingStart = 0;
+  resetStats();
+  memset(&_wakeReport, 0, sizeof(_wakeReport));
+  _resumeSlot = 96;
+  _serverIp = 0;
+  _resumeServerIp = 0;
+  _transport = nullptr;
+  _transportNonBlocking = false;
+  _step.state = StepState::Idle;
+  _step.client = nullptr;
+  _step.file = nullptr;
+  _step.data = nullptr;
+  _step.locked = false;
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  memset(&_memoryProfile, 0, sizeof(_memoryProfile));
+  _blocksBefore = 0;
+#endif
+  _tlsDirty = true;
+#if WAAVIS_ENABLE_TLS
+  _fingerprintLen = 0;
+#endif
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  _trustAnchors = nullptr;
+  _pinnedKey = nullptr;
+  _secureClient.setSession(&_tlsSession);
+  _tlsFragmentLength = 512;
+  _tlsFragmentSupported = -1;
+  _relayProbePort = 0;
+  _relayFragmentSupported = false;
+#endif
+}
+
+// The ESP32 destructor also stops the async worker (WaavisAsync.cpp).
+#if !defined(ESP32)
+WaavisClient::~WaavisClient() {
+#if WAAVIS_ENABLE_OUTBOX
+  free(_outboxStage);
+#endif
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  delete _trustAnchors;
+  delete _pinnedKey;
+#endif
+}
+#endif
+
+void WaavisClient::setInsecure(bool insecure) {
+  _insecure = insecure;
+  _tlsDirty = true;
+}
+
+bool WaavisClient::setCertificate(const char* cert) {
+  if (cert == nullptr || cert[0] == '\0') {
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+    delete _trustAnchors;
+    _trustAnchors = nullptr;
+#endif
+    _sslCert = nullptr;
+    _insecure = true;
+    _tlsDirty = true;
+    return true;
+  }
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  // Parsed once here instead of on every handshake.
+  BearSSL::X509List *anchors = new BearSSL::X509List(cert);
+  bool valid = anchors->getCount() > 0;
 #else
-#define WAAVIS_LOG(message) do {} while (0)
+  // mbedTLS parses the PEM during the handshake; check only that there is one.
+  bool valid = strstr(cert, "-----BEGIN CERTIFICATE-----") != nullptr;
 #endif
+  if (!valid) {
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+    delete anchors;
+#endif
+    _lastError = "Invalid certificate";
+    WAAVIS_TRACE(ERROR, InvalidCertificate, 0);
+    return false;
+  }
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  delete _trustAnchors;
+  _trustAnchors = anchors;
+#endif
+  _sslCert = cert;
+  _insecure = false;
+  _tlsDirty = true;
+  return true;
+}
+
+#if WAAVIS_ENABLE_TLS
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool WaavisClient::setFingerprint(const char *fingerprint) {
+  _tlsDirty = true;
+  _fingerprintLen = 0;
+  if (fingerprint == nullptr || fingerprint[0] == '\0') {
+    return true;
+  }
 
 #if defined(ESP8266)
-#include <ESP8266HTTPClient.h>
-#include <ESP8266WiFi.h>
-#include <WiFiClientSecureBearSSL.h>
-#elif defined(ESP32)
-#include <HTTPClient.h>
-#include <WiFi.h>
-#include <WiFiClientSecure.h>
-#include <HardwareSerial.h>
-#include <SPIFFS.h>
-#include <FS.h>
+  const size_t expected = 20;  // SHA-1, as BearSSL checks it
 #else
-#error "Waavis library supports ESP8266 and ESP32 only."
+  const size_t expected = 32;  // SHA-256, as WiFiClientSecure::verify() checks it
+#endif
+  size_t len = 0;
+  for (const char *p = fingerprint; *p != '\0';) {
+    if (*p == ':' || *p == ' ') {
+      ++p;
+      continue;
+    }
+    int high = hexValue(p[0]);
+    int low = high < 0 ? -1 : hexValue(p[1]);
+    if (low < 0 || len == expected) {
+      _lastError = "Invalid fingerprint";
+      return false;
+    }
+    _fingerprint[len++] = static_cast<uint8_t>((high << 4) | low);
+    p += 2;
+  }
+  if (len != expected) {
+    _lastError = "Invalid fingerprint";
+    return false;
+  }
+  _fingerprintLen = static_cast<uint8_t>(len);
+  return true;
+}
+
+#if defined(ESP8266)
+bool WaavisClient::setPublicKey(const char *pem) {
+  _tlsDirty = true;
+  delete _pinnedKey;
+  _pinnedKey = nullptr;
+  if (pem == nullptr || pem[0] == '\0') {
+    return true;
+  }
+  _pinnedKey = new BearSSL::PublicKey();
+  if (!_pinnedKey->parse(pem)) {
+    delete _pinnedKey;
+    _pinnedKey = nullptr;
+    _lastError = "Invalid public key";
+    return false;
+  }
+  return true;
+}
 #endif
 
-WaavisClient::WaavisClient(const String &baseUrl)
-    : _baseUrl(baseUrl), _insecure(true), _sslCert(nullptr), _lastError("") {}
+// Hands the pre-parsed trust settings to the TLS client. Pins take
+// precedence over the certificate, which takes precedence over insecure.
+// Fails when none is set (setInsecure(false) without a certificate or pin):
+// the TLS client would otherwise keep whatever mode it was last given.
+bool WaavisClient::applyTlsTrust() {
+  bool trusted = _fingerprintLen != 0 || _sslCert != nullptr || _insecure;
+#if defined(ESP8266)
+  trusted = trusted || _pinnedKey != nullptr;
+#endif
+  if (!trusted) {
+    _lastError = "No certificate or pin set";
+    WAAVIS_TRACE(ERROR, InvalidCertificate, 1);
+    return false;
+  }
+  if (!_tlsDirty) {
+    return true;
+  }
+  _tlsDirty = false;
+#if defined(ESP8266)
+  if (_pinnedKey != nullptr) {
+    _secureClient.setKnownKey(_pinnedKey);
+  } else if (_fingerprintLen != 0) {
+    _secureClient.setFingerprint(_fingerprint);
+  } else if (_trustAnchors != nullptr) {
+    _secureClient.setTrustAnchors(_trustAnchors);
+  } else if (_insecure) {
+    _secureClient.setInsecure();
+  }
+#else
+  // mbedTLS takes the CA as PEM and parses it during each handshake; with a
+  // pin the chain is not verified at all and the peer certificate's hash is
+  // compared after connect().
+  if (_fingerprintLen != 0) {
+    _secureClient.setInsecure();
+  } else if (_sslCert != nullptr) {
+    _secureClient.setCACert(_sslCert);
+  } else if (_insecure) {
+    _secureClient.setInsecure();
+  }
+#endif
+  return true;
+}
+#endif
+
+void WaavisClient::setKeepAlive(bool keepAlive) {
+  _keepAlive = keepAlive;
+  if (!keepAlive) {
+    stop();
+  }
+}
+
+void WaavisClient::setIdleTimeout(unsigned long idleTimeoutMs) {
+  _idleTimeout = idleTimeoutMs;
+}
+
+void WaavisClient::setDeadline(unsigned long deadlineMs) {
+  _deadline = deadlineMs;
+}
+
+#if WAAVIS_ENABLE_MEDIA
+void WaavisClient::setStreamIdleTimeout(unsigned long idleTimeoutMs) {
+  _streamIdleTimeout = idleTimeoutMs;
+}
+#endif
+
+void WaavisClient::setPipelineDepth(uint8_t depth) {
+  _pipelineDepth = depth == 0 ? 1 : depth;
+}
+
+void WaavisClient::setTransport(Client *client, bool nonBlocking) {
+  WAAVIS_IO_LOCK();
+  // A connection left open on the old path would be reused as if it were
+  // the new one.
+  stop();
+  _transport = client;
+  _transportNonBlocking = client != nullptr && nonBlocking;
+}
+
+void WaavisClient::stop() {
+  WAAVIS_IO_LOCK();
+  if (_transport != nullptr) {
+    _transport->stop();
+  }
+#if WAAVIS_ENABLE_TLS
+  _secureClient.stop();
+#endif
+  _plainClient.stop();
+}
+
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+void WaavisClient::setTlsFragmentLength(uint16_t length) {
+  WAAVIS_IO_LOCK();
+  if (length != 512 && length != 1024 && length != 2048 && length != 4096) {
+    length = 0;
+  }
+  _tlsFragmentLength = length;
+  _tlsFragmentSupported = -1;
+  stop();
+}
+
+// BearSSL keeps a 16 KB receive buffer unless the server agrees to smaller
+// records (Maximum Fragment Length, RFC 6066). Ask once per client; the
+// probe costs one extra partial handshake.
+void WaavisClient::applyTlsBufferSizes() {
+  if (_tlsFragmentLength == 0) {
+    _secureClient.setBufferSizes(16384, 512);
+    return;
+  }
+  if (_tlsFragmentSupported < 0) {
+    _tlsFragmentSupported = BearSSL::WiFiClientSecure::probeMaxFragmentLength(
+                                _host.c_str(), _port, _tlsFragmentLength)
+                                ? 1
+                                : 0;
+    WAAVIS_TRACE(INFO, TlsFragmentLength, _tlsFragmentSupported ? _tlsFragmentLength : 0);
+  }
+  if (_tlsFragmentSupported) {
+    _secureClient.setBufferSizes(_tlsFragmentLength, _tlsFragmentLength);
+  } else {
+    _secureClient.setBufferSizes(16384, 512);
+  }
+}
+#endif
+
+uint32_t WaavisClient::tlsSessionHits() const {
+  return _tlsSessionHits;
+}
+
+uint32_t WaavisClient::tlsSessionMisses() const {
+  return _tlsSessionMisses;
+}
+
+String WaavisClient::lastError() const {
+  WAAVIS_IO_LOCK();
+  return _lastError;
+}
+
+WaavisResponse WaavisClient::lastResponse() const {
+  WAAVIS_IO_LOCK();
+  return _lastResponse;
+}
+
+bool waavisWaitForData(Client &client, unsigned long timeoutMs) {
+  unsigned long start = millis();
+  while (client.available() <= 0) {
+    if (!client.connected() || millis() - start > timeoutMs) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+// Reads one CRLF-terminated line into line (truncated to size - 1).
+// Returns the stored length or -1 if the connection closed or no byte
+// arrived within timeoutMs.
+int waavisReadLine(Client &client, char *line, size_t size,
+                   unsigned long timeoutMs) {
+  size_t len = 0;
+  while (true) {
+    if (!waavisWaitForData(client, timeoutMs)) {
+      return -1;
+    }
+    int c = client.read();
+    if (c < 0) {
+      continue;
+    }
+    if (c == '\n') {
+      break;
+    }
+    if (c != '\r' && len + 1 < size) {
+      line[len++] = static_cast<char>(c);
+    }
+  }
+  line[len] = '\0';
+  return static_cast<int>(len);
+}
+
+bool waavisHeaderIs(const char *line, const char *name, const char **value) {
+  size_t len = strlen(name);
+  if (strncasecmp(line, name, len) != 0 || line[len] != ':') {
+    return false;
+  }
+  const char *v = line + len + 1;
+  while (*v == ' ' || *v == '\t') {
+    ++v;
+  }
+  *value = v;
+  return true;
+}
+
+// Feeds length body bytes to the scanner in fixed-size blocks.
+bool WaavisClient::readBody(Client &client, size_t length, WaavisJsonScanner &scanner) {
+  uint8_t buffer[128];
+  while (length > 0) {
+    if (!waavisWaitForData(client, waitBudget(kResponseTimeoutMs))) {
+      return false;
+    }
+    size_t toRead = length < sizeof(buffer) ? length : sizeof(buffer);
+    int n = client.read(buffer, toRead);
+    if (n <= 0) {
+      continue;
+    }
+    scanner.feed(buffer, static_cast<size_t>(n));
+    length -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+bool waavisWriteAll(Client &client, const uint8_t *data, size_t len) {
+  while (len > 0) {
+    size_t written = client.write(data, len);
+    if (written == 0) {
+      return false;
+    }
+    data += written;
+    len -= written;
+  }
+  return true;
+}
+
+bool waavisWriteAll(Client &client, const String &data) {
+  return waavisWriteAll(client, reinterpret_cast<const uint8_t *>(data.c_str()), data.length());
+}
+
+bool WaavisClient::linkUp() const {
+  return _transport != nullptr || WiFi.status() == WL_CONNECTED;
+}
+
+// Caps a wait at what is left of the call's deadline.
+unsigned long WaavisClient::waitBudget(unsigned long capMs) const {
+  if (_deadline == 0) {
+    return capMs;
+  }
+  unsigned long elapsed = millis() - _deadlineStart;
+  if (elapsed >= _deadline) {
+    return 0;
+  }
+  return _deadline - elapsed < capMs ? _deadline - elapsed : capMs;
+}
+
+// True once the deadline has passed; the error then names the first phase
+// that did not complete.
+bool WaavisClient::timedOut() {
+  if (_deadline == 0 || millis() - _deadlineStart < _deadline) {
+    return false;
+  }
+  const uint32_t *at = _lastTiming.at;
+  WaavisPhase phase;
+  if (at[static_cast<uint8_t>(WaavisPhase::BodySent)] != 0) {
+    phase = WaavisPhase::Done;
+    _lastError = "Response timeout";
+  } else if (at[static_cast<uint8_t>(WaavisPhase::Connect)] != 0 || _lastTiming.reused) {
+    phase = WaavisPhase::BodySent;
+    _lastError = "Upload timeout";
+  } else if (at[static_cast<uint8_t>(WaavisPhase::Resolve)] != 0) {
+    phase = WaavisPhase::Connect;
+    _lastError = "Connect timeout";
+  } else {
+    phase = WaavisPhase::Resolve;
+    _lastError = "DNS timeout";
+  }
+  WAAVIS_TRACE(ERROR, Timeout, static_cast<uint8_t>(phase));
+  return true;
+}
+
+Client *WaavisClient::openConnection(bool &reused) {
+  reused = false;
+  if (_host.length() == 0) {
+    _lastError = "Invalid base URL";
+    WAAVIS_TRACE(ERROR, InvalidBaseUrl, 0);
+    return nullptr;
+  }
+
+  Client *client = _transport;
+  if (client == nullptr) {
+#if WAAVIS_ENABLE_TLS
+    client = _https ? static_cast<Client *>(&_secureClient)
+                    : static_cast<Client *>(&_plainClient);
+#else
+    if (_https) {
+      _lastError = "HTTPS support disabled";
+      WAAVIS_TRACE(ERROR, HttpsDisabled, 0);
+      return nullptr;
+    }
+    client = &_plainClient;
+#endif
+  }
+  if (_keepAlive && client->connected() &&
+      millis() - _lastActivity < _idleTimeout) {
+    // Drop anything a previous exchange left behind so the next status line
+    // read belongs to this request.
+    while (client->available() > 0) {
+      client->read();
+    }
+    reused = true;
+    _lastTiming.reused = true;
+    return client;
+  }
+  client->stop();
+  // A replaced stale connection no longer counts as reused.
+  _lastTiming.reused = false;
+
+  if (_transport != nullptr) {
+    // Name resolution and any TLS happen inside the transport's connect().
+    markPhase(WaavisPhase::Resolve);
+    client->setTimeout(waitBudget(kConnectTimeoutMs));
+    if (!client->connect(_host.c_str(), _port)) {
+      if (!timedOut()) {
+        _lastError = "HTTP connect failed";
+        WAAVIS_TRACE(ERROR, ConnectFailed, 2);
+      }
+      return nullptr;
+    }
+    if (timedOut()) {
+      client->stop();
+      return nullptr;
+    }
+    // A non-blocking transport is connected once it first takes data; a
+    // step send marks it then.
+    if (!_transportNonBlocking || _step.state == StepState::Idle) {
+      markPhase(WaavisPhase::Connect);
+    }
+    _lastActivity = millis();
+    return client;
+  }
+
+  // Resolve up front so DNS time is measured on its own. An address carried
+  // over deep sleep skips DNS, except for HTTPS on ESP8266 where BearSSL can
+  // only connect by name (and resolves again inside connect()).
+  IPAddress address;
+  bool cachedAddress = _resumeServerIp != 0;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  cachedAddress = cachedAddress && !_https;
+#endif
+  if (timedOut()) {
+    return nullptr;
+  }
+  if (cachedAddress) {
+    address = IPAddress(_resumeServerIp);
+#if defined(ESP8266)
+  } else if (!WiFi.hostByName(_host.c_str(), address, waitBudget(10000))) {
+#else
+  } else if (!WiFi.hostByName(_host.c_str(), address)) {
+#endif
+    if (!timedOut()) {
+      _lastError = "DNS lookup failed";
+      WAAVIS_TRACE(ERROR, DnsFailed, 0);
+    }
+    return nullptr;
+  }
+  if (timedOut()) {
+    return nullptr;
+  }
+  _serverIp = static_cast<uint32_t>(address);
+  markPhase(WaavisPhase::Resolve);
+
+#if WAAVIS_ENABLE_TLS
+  if (_https) {
+#if defined(ESP8266)
+    applyTlsBufferSizes();
+#endif
+    if (!applyTlsTrust()) {
+      return nullptr;
+    }
+  }
+
+#if defined(ESP8266)
+  // BearSSL rewrites the session after every full handshake and leaves it
+  // untouched when the server accepted the cached one.
+  BearSSL::Session previous = _tlsSession;
+#endif
+#endif
+  // Both cores bound connect() (and the TLS handshake on ESP8266) by the
+  // Stream timeout.
+  unsigned long connectBudget = waitBudget(kConnectTimeoutMs);
+  client->setTimeout(connectBudget);
+#if WAAVIS_ENABLE_TLS && (defined(ESP32) || defined(WAAVIS_HOST))
+  if (_https) {
+    _secureClient.setHandshakeTimeout(_deadline != 0 ? (connectBudget + 999) / 1000 : 120);
+  }
+#endif
+  bool connected;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  connected = _https ? _secureClient.connect(_host.c_str(), _port)
+                     : _plainClient.connect(address, _port);
+#elif WAAVIS_ENABLE_TLS
+  // Connecting by address still sends the host name for SNI and checks.
+  connected = _https ? _secureClient.connect(address, _port, _host.c_str(),
+                                             _fingerprintLen != 0 ? nullptr : _sslCert,
+                                             nullptr, nullptr)
+                     : _plainClient.connect(address, _port);
+#else
+  connected = _plainClient.connect(address, _port);
+#endif
+  if (!connected && timedOut()) {
+    client->stop();
+    return nullptr;
+  }
+  if (!connected && cachedAddress) {
+    // The server may have moved while we slept.
+    _resumeServerIp = 0;
+    WAAVIS_TRACE(INFO, SavedAddressFailed, 0);
+    return openConnection(reused);
+  }
+  if (!connected) {
+    _lastError = "HTTP connect failed";
+    WAAVIS_TRACE(ERROR, ConnectFailed, _https ? 1 : 0);
+    return nullptr;
+  }
+  if (timedOut()) {
+    client->stop();
+    return nullptr;
+  }
+  markPhase(WaavisPhase::Connect);
+#if WAAVIS_ENABLE_TLS
+  if (_https) {
+    markPhase(WaavisPhase::Handshake);
+#if defined(ESP32) || defined(WAAVIS_HOST)
+    if (_fingerprintLen != 0) {
+      char hex[2 * sizeof(_fingerprint) + 1];
+      for (uint8_t i = 0; i < _fingerprintLen; ++i) {
+        snprintf(hex + 2 * i, 3, "%02x", _fingerprint[i]);
+      }
+      if (!_secureClient.verify(hex, nullptr)) {
+        client->stop();
+        _lastError = "Certificate fingerprint mismatch";
+        WAAVIS_TRACE(ERROR, FingerprintMismatch, 0);
+        return nullptr;
+      }
+    }
+#endif
+#if defined(ESP8266)
+    const BearSSL::Session empty;
+    bool resumed = memcmp(&previous, &empty, sizeof(empty)) != 0 &&
+                   memcmp(&previous, &_tlsSession, sizeof(previous)) == 0;
+#else
+    bool resumed = false;
+#endif
+    if (resumed) {
+      ++_tlsSessionHits;
+    } else {
+      ++_tlsSessionMisses;
+    }
+  }
+#endif
+  _lastActivity = millis();
+  return client;
+}
+
+// contentLength < 0 announces a chunked body; 0 sends no body headers.
+String WaavisClient::requestHead(const char *method, const String &path,
+                                 const String &token, const String &contentType,
+                                 long contentLength) const {
+  String head;
+  head.reserve(160 + path.length() + token.length() + contentType.length());
+  head += method;
+  head += ' ';
+  head += _basePath;
+  head += path;
+  head += " HTTP/1.1\r\nHost: ";
+  head += _host;
+  if (_port != (_https ? 443 : 80)) {
+    head += ':';
+    head += String(_port);
+  }
+  head += "\r\n";
+  if (token.length() > 0) {
+    head += "Authorization: ";
+    head += token;
+    head += "\r\n";
+  }
+  if (contentType.length() > 0) {
+    head += "Content-Type: ";
+    head += contentType;
+    head += "\r\n";
+  }
+  if (contentLength < 0) {
+    head += "Transfer-Encoding: chunked\r\n";
+  } else if (contentLength > 0) {
+    head += "Content-Length: ";
+    head += String(contentLength);
+    head += "\r\n";
+  }
+  head += _keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+  return head;
+}
+
+bool WaavisClient::writeRequestHead(Client &client, const char *method,
+                                    const String &path, const String &token,
+                                    const String &contentType,
+                                    long contentLength) {
+  return waavisWriteAll(client, requestHead(method, path, token, contentType, contentLength));
+}
+
+// Reads the full response into _lastResponse so the connection can carry the
+// next request. Returns false if the connection broke before the response
+// was complete.
+bool WaavisClient::readResponse(Client &client) {
+  char line[128];
+  memset(&_lastResponse, 0, sizeof(_lastResponse));
+  _lastResponse.status = -1;
+  _closedUnanswered = false;
+  if (!waavisWaitForData(client, waitBudget(kResponseTimeoutMs))) {
+    // A close is the server dropping the connection without reading the
+    // request; a silent open connection may still be processing it.
+    _closedUnanswered = !client.connected();
+    stop();
+    return false;
+  }
+  markPhase(WaavisPhase::FirstByte);
+  if (waavisReadLine(client, line, sizeof(line), waitBudget(kResponseTimeoutMs)) < 0 ||
+      strncmp(line, "HTTP/", 5) != 0) {
+    stop();
+    return false;
+  }
+  const char *space = strchr(line, ' ');
+  if (space == nullptr) {
+    stop();
+    return false;
+  }
+  int status = atoi(space + 1);
+
+  long contentLength = -1;
+  bool chunked = false;
+  bool close = !_keepAlive;
+  while (true) {
+    int len = waavisReadLine(client, line, sizeof(line), waitBudget(kResponseTimeoutMs));
+    if (len < 0) {
+      stop();
+      return false;
+    }
+    if (len == 0) {
+      break;
+    }
+    const char *value = nullptr;
+    if (waavisHeaderIs(line, "Content-Length", &value)) {
+      contentLength = atol(value);
+    } else if (waavisHeaderIs(line, "Transfer-Encoding", &value)) {
+      chunked = strncasecmp(value, "chunked", 7) == 0;
+    } else if (waavisHeaderIs(line, "Connection", &value)) {
+      close = close || strncasecmp(value, "close", 5) == 0;
+    }
+  }
+
+  WaavisJsonScanner scanner(_lastResponse);
+  bool ok = true;
+  if (status == 204 || status == 304 || (status >= 100 && status < 200)) {
+    // No body.
+  } else if (chunked) {
+    while (ok) {
+      if (waavisReadLine(client, line, sizeof(line), waitBudget(kResponseTimeoutMs)) < 0) {
+        ok = false;
+        break;
+      }
+      size_t chunkSize = static_cast<size_t>(strtoul(line, nullptr, 16));
+      if (chunkSize == 0) {
+        // Trailer section ends with an empty line.
+        int len;
+        while ((len = waavisReadLine(client, line, sizeof(line),
+                                     waitBudget(kResponseTimeoutMs))) > 0) {
+        }
+        ok = len == 0;
+        break;
+      }
+      ok = readBody(client, chunkSize, scanner) &&
+           waavisReadLine(client, line, sizeof(line), waitBudget(kResponseTimeoutMs)) == 0;
+    }
+  } else if (contentLength >= 0) {
+    ok = readBody(client, static_cast<size_t>(contentLength), scanner);
+  } else {
+    // Body delimited by connection close.
+    uint8_t buffer[128];
+    while (waavisWaitForData(client, waitBudget(kResponseTimeoutMs))) {
+      int n = client.read(buffer, sizeof(buffer));
+      if (n > 0) {
+        scanner.feed(buffer, static_cast<size_t>(n));
+      }
+    }
+    // Still open means the wait gave up; that is only an error once the
+    // deadline is spent.
+    ok = !client.connected() || waitBudget(1) != 0;
+    close = true;
+  }
+  // The status is only reported once the whole response has been read.
+  _lastResponse.status = ok ? status : -1;
+
+  if (!ok || close) {
+    stop();
+  } else {
+    _lastActivity = millis();
+  }
+  return ok;
+}
+
+bool WaavisClient::finishResponse() {
+  int status = _lastResponse.status;
+  if (status >= 200 && status < 300) {
+    _lastResponse.error[0] = '\0';
+    _lastError = "";
+    return true;
+  }
+
+  if (_lastResponse.error[0] != '\0') {
+    _lastError = _lastResponse.error;
+  } else {
+    _lastError = "HTTP " + String(status);
+  }
+  WAAVIS_TRACE(ERROR, HttpError, status);
+  return false;
+}
+
+// The body is head, then the encoded form, then dataSize bytes at data, then
+// tail.
+bool WaavisClient::sendRequest(const char *method, const String &path,
+                               const String &token, const String &contentType,
+                               const String &head, const uint8_t *data,
+                               size_t dataSize, const String &tail,
+                               const WaavisForm *form) {
+  _lastResponse.status = -1;
+  _requestStarted = false;
+  if (stepBusy()) {
+    return false;
+  }
+  WaavisEndpoint endpoint = path.startsWith("/v1/send_chat_media")
+                                ? WaavisEndpoint::SendChatMedia
+                            : path.startsWith("/v1/send_chat_link")
+                                ? WaavisEndpoint::SendChatLink
+                                : WaavisEndpoint::SendChat;
+  timingBegin();
+  // A reused connection may have been closed by the server while idle; if it
+  // was closed before any response byte, retry once on a fresh connection.
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    bool reused = false;
+    Client *client = openConnection(reused);
+    if (client == nullptr) {
+      timingEnd(endpoint, false);
+      return false;
+    }
+
+    size_t formLength = form != nullptr ? form->length() : 0;
+    long contentLength =
+        static_cast<long>(head.length() + formLength + dataSize + tail.length());
+    bool sent = writeRequestHead(*client, method, path, token, contentType, contentLength);
+    // A replay on a fresh connection starts over; only the last attempt counts.
+    _requestStarted = sent;
+    if (sent) {
+      markPhase(WaavisPhase::HeadersSent);
+      beginUpload(dataSize);
+      sent = waavisWriteAll(*client, head) && (form == nullptr || form->writeTo(*client)) &&
+             writeUpload(*client, data, dataSize) && waavisWriteAll(*client, tail);
+    }
+    if (sent) {
+      markPhase(WaavisPhase::BodySent);
+      endUpload();
+    } else if (uploadCancelled()) {
+      stop();
+      _lastError = "Upload cancelled";
+      timingEnd(endpoint, false);
+      return false;
+    }
+    bool closed;
+    if (sent) {
+      if (readResponse(*client)) {
+        bool ok = finishResponse();
+        timingEnd(endpoint, ok);
+        return ok;
+      }
+      closed = _closedUnanswered;
+    } else {
+      closed = !client->connected();
+    }
+
+    stop();
+    if (timedOut()) {
+      timingEnd(endpoint, false);
+      return false;
+    }
+    // After a timeout or a partial response the server may have acted on
+    // the request; sending it again could deliver the message twice.
+    if (!reused || !closed) {
+      break;
+    }
+    WAAVIS_TRACE(INFO, StaleConnection, 0);
+  }
+  _lastError = "HTTP connection lost";
+  timingEnd(endpoint, false);
+  return false;
+}
+
+// Sends a replayable request; with an outbox configured, requests that never
+// left the device are journaled for processOutbox() instead of dropped. Once
+// the request may have reached the server, journaling it could deliver the
+// message twice, so the call fails with the real error instead.
+bool WaavisClient::sendOrQueue(const char *method, const String &path,
+                               const String &token, const WaavisForm *form) {
+  if (stepBusy()) {
+    return false;
+  }
+#if !WAAVIS_ENABLE_OUTBOX
+  if (!linkUp()) {
+    _lastError = "WiFi not connected";
+    return false;
+  }
+  return sendRequest(method, path, token, form == nullptr ? "" : kFormContentType,
+                     String(), nullptr, 0, String(), form);
+#else
+  if (linkUp()) {
+    const char *contentType = form == nullptr ? "" : kFormContentType;
+    if (sendRequest(method, path, token, contentType, String(), nullptr, 0,
+                    String(), form)) {
+      return true;
+    }
+    // A deadline bounds this call; the caller must see it run out (the
+    // error names the phase) rather than a queued success.
+    if (_outboxFs == nullptr || _lastResponse.status >= 0 || _requestStarted ||
+        timedOut()) {
+      return false;
+    }
+  } else if (_outboxFs == nullptr) {
+    _lastError = "WiFi not connected";
+    return false;
+  }
+
+  // Only a journaled request needs the body as one block.
+  String body;
+  if (form != nullptr) {
+    form->appendTo(body);
+  }
+  return queueOutbox(method, path, token, body);
+#endif
+}
+
+bool WaavisClient::sendChat(const String &token, const String &to, const String &message) {
+  WAAVIS_IO_LOCK();
+  WaavisForm query;
+  query.add("token", token);
+  query.add("to", to);
+  query.add("message", message);
+  String path = "/v1/send_chat?";
+  query.appendTo(path);
+  return sendOrQueue("GET", path, "", nullptr);
+}
+
+bool WaavisClient::sendChatPost(const String &token, const String &to,
+                                const String &message, bool typing) {
+  WAAVIS_IO_LOCK();
+  WaavisForm form;
+  form.add("to", to);
+  form.add("message", message);
+  form.add("typing", typing ? "true" : "false");
+  return sendOrQueue("POST", "/v1/send_chat", token, &form);
+}
+
+bool WaavisClient::sendChatTemplate(const String &token, const String &to,
+                                    const WaavisTemplate &message,
+                                    std::initializer_list<WaavisValue> values,
+                                    bool typing) {
+  WAAVIS_IO_LOCK();
+  WaavisForm form;
+  form.add("to", to);
+  form.add("message", message, values.begin(), values.size());
+  form.add("typing", typing ? "true" : "false");
+  return sendOrQueue("POST", "/v1/send_chat", token, &form);
+}
+
+size_t WaavisClient::sendChatBatch(const String &token, const String recipients[],
+                                   size_t count, const String &message,
+                                   bool typing, bool *results) {
+  WAAVIS_IO_LOCK();
+  for (size_t i = 0; results != nullptr && i < count; ++i) {
+    results[i] = false;
+  }
+  if (stepBusy()) {
+    return 0;
+  }
+  if (!linkUp()) {
+    _lastError = "WiFi not connected";
+    return 0;
+  }
+
+  // Every recipient gets the same message; encode it once for the batch.
+  String encodedMessage;
+  WaavisForm::encodeValue(message, encodedMessage);
+  String lastFailure;
+  size_t sent = 0;
+  size_t next = 0;
+  uint8_t depth = _pipelineDepth;
+  bool retried = false;
+  timingBegin();
+  while (next < count) {
+    bool reused = false;
+    Client *client = openConnection(reused);
+    if (client == nullptr) {
+      lastFailure = _lastError;
+      break;
+    }
+
+    size_t window = count - next < depth ? count - next : depth;
+    size_t written = 0;
+    while (written < window) {
+      WaavisForm form;
+      form.add("to", recipients[next + written]);
+      form.addEncoded("message", encodedMessage);
+      form.add("typing", typing ? "true" : "false");
+      if (!writeRequestHead(*client, "POST", "/v1/send_chat", token,
+                            kFormContentType, static_cast<long>(form.length()))) {
+        break;
+      }
+      markPhase(WaavisPhase::HeadersSent);
+      if (!form.writeTo(*client)) {
+        break;
+      }
+      ++written;
+    }
+    markPhase(WaavisPhase::BodySent);
+
+    size_t answered = 0;
+    bool closed = !client->connected();
+    while (answered < written) {
+      if (!readResponse(*client)) {
+        closed = _closedUnanswered;
+        break;
+      }
+      bool ok = finishResponse();
+      if (results != nullptr) {
+        results[next + answered] = ok;
+      }
+      if (ok) {
+        ++sent;
+      } else {
+        lastFailure = _lastError;
+      }
+      ++answered;
+      // The server closed the connection after this response; anything
+      // still in flight was not processed.
+      if (!client->connected()) {
+        closed = true;
+        break;
+      }
+    }
+    next += answered;
+
+    if (answered < window) {
+      stop();
+      if (timedOut()) {
+        lastFailure = _lastError;
+        break;
+      }
+      // The request in flight may have been processed; see sendRequest().
+      if (!closed) {
+        lastFailure = "HTTP connection lost";
+        break;
+      }
+      // Resend what is left one request at a time on a fresh connection.
+      depth = 1;
+      if (answered == 0) {
+        if (!reused || retried) {
+          lastFailure = "HTTP connection lost";
+          break;
+        }
+        retried = true;
+      } else {
+        retried = false;
+      }
+    }
+  }
 
-void WaavisClient::setInsecure(bool insecure) {
-  _insecure = insecure;
+  timingEnd(WaavisEndpoint::SendChat, sent == count);
+  _lastError = sent == count ? "" : lastFailure;
+  return sent;
 }
 
-void WaavisClient::setCertificate(const char* cert) {
-  if (cert == nullptr || cert[0] == '\0') {
-    _sslCert = nullptr;
-    _insecure = true;
-    return;
-  }
-  _sslCert = cert;
-  _insecure = false;
+#if WAAVIS_ENABLE_LINK
+bool WaavisClient::sendChatLink(const String &token, const String &to,
+                                const String &message, bool typing,
+                                const String &link, const String &linkTitle,
+                                const String &linkDescription) {
+  WAAVIS_IO_LOCK();
+  WaavisForm form;
+  form.add("to", to);
+  form.add("message", message);
+  form.add("typing", typing ? "true" : "false");
+  form.add("link", link);
+  form.add("link_title", linkTitle);
+  form.add("link_description", linkDescription);
+  return sendOrQueue("POST", "/v1/send_chat_link", token, &form);
 }
+#endif
 
-String WaavisClient::lastError() const {
-  return _lastError;
+#if WAAVIS_ENABLE_MEDIA
+void WaavisClient::onUploadProgress(WaavisProgressCallback callback, void *arg) {
+  _progressCallback = callback;
+  _progressArg = arg;
 }
 
-bool WaavisClient::sendChat(const String &token, const String &to, const String &message) {
-  if (WiFi.status() != WL_CONNECTED) {
-    _lastError = "WiFi not connected";
-    return false;
-  }
+uint32_t WaavisClient::uplinkBandwidth() const {
+  return _uplinkBandwidth;
+}
+#endif
 
-  String url = _baseUrl + "/v1/send_chat?token=" + urlEncode(token) +
-               "&to=" + urlEncode(to) +
-               "&message=" + urlEncode(message);
+void WaavisClient::beginUpload(size_t total) {
+#if WAAVIS_ENABLE_MEDIA
+  _uploadSent = 0;
+  _uploadTotal = total;
+  _uploadStart = millis();
+  _uploadCancelled = false;
+#else
+  (void)total;
+#endif
+}
 
-#if defined(ESP8266)
-  BearSSL::WiFiClientSecure client;
-  if (_insecure) {
-    client.setInsecure();
-  }
-  HTTPClient http;
-  if (!http.begin(client, url)) {
-    _lastError = "HTTP begin failed";
-    return false;
-  }
-#elif defined(ESP32)
-  WiFiClientSecure client;
-  if (_insecure) {
-    client.setInsecure();
+// Counts bytes of the media part and reports them; false means the progress
+// callback asked to cancel.
+bool WaavisClient::reportUpload(size_t bytes) {
+#if WAAVIS_ENABLE_MEDIA
+  _uploadSent += bytes;
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  sampleMemory();
+#endif
+  if (_progressCallback == nullptr) {
+    return true;
   }
-  HTTPClient http;
-  if (!http.begin(client, url)) {
-    _lastError = "HTTP begin failed";
+  unsigned long elapsed = millis() - _uploadStart;
+  uint32_t rate = elapsed == 0 ? 0
+                               : static_cast<uint32_t>(
+                                     static_cast<uint64_t>(_uploadSent) * 1000 / elapsed);
+  if (!_progressCallback(_uploadSent, _uploadTotal, rate, _progressArg)) {
+    _uploadCancelled = true;
     return false;
   }
+#else
+  (void)bytes;
 #endif
+  return true;
+}
 
-  int httpCode = http.GET();
-  if (httpCode <= 0) {
-    _lastError = http.errorToString(httpCode);
-    http.end();
-    return false;
-  }
-
-  if (httpCode < 200 || httpCode >= 300) {
-    String response = http.getString();
-    WAAVIS_LOG("[waavis] response: " + response);
-    
-    // Extract error from JSON
-    int errorIdx = response.indexOf("\"error\":");
-    if (errorIdx >= 0) {
-      int startQuote = response.indexOf('"', errorIdx + 8);
-      int endQuote = response.indexOf('"', startQuote + 1);
-      if (startQuote >= 0 && endQuote > startQuote) {
-        _lastError = response.substring(startQuote + 1, endQuote);
-      } else {
-        _lastError = "HTTP " + String(httpCode);
-      }
-    } else {
-      _lastError = "HTTP " + String(httpCode);
-    }
-    http.end();
-    return false;
+// Folds the finished upload into the bandwidth average (weight 1/4).
+void WaavisClient::endUpload() {
+#if WAAVIS_ENABLE_MEDIA
+  unsigned long elapsed = millis() - _uploadStart;
+  if (_uploadSent == 0 || elapsed == 0) {
+    return;
   }
-
-  _lastError = "";
-  http.end();
-  return true;
+  uint32_t sample = static_cast<uint32_t>(
+      static_cast<uint64_t>(_uploadSent) * 1000 / elapsed);
+  _uplinkBandwidth = _uplinkBandwidth == 0
+                         ? sample
+                         : _uplinkBandwidth - _uplinkBandwidth / 4 + sample / 4;
+#endif
 }
 
-bool WaavisClient::sendChatPost(const String &token, const String &to,
-                                const String &message, bool typing) {
-  String body = "to=" + urlEncode(to) +
-                "&message=" + urlEncode(message) +
-                "&typing=" + String(typing ? "true" : "false");
-  return sendPost("/v1/send_chat", token, body);
+bool WaavisClient::uploadCancelled() const {
+#if WAAVIS_ENABLE_MEDIA
+  return _uploadCancelled;
+#else
+  return false;
+#endif
 }
 
-bool WaavisClient::sendChatLink(const String &token, const String &to,
-                                const String &message, bool typing,
-                                const String &link, const String &linkTitle,
-                                const String &linkDescription) {
-  String body = "to=" + urlEncode(to) +
-                "&message=" + urlEncode(message) +
-                "&typing=" + String(typing ? "true" : "false") +
-                "&link=" + urlEncode(link) +
-                "&link_title=" + urlEncode(linkTitle) +
-                "&link_description=" + urlEncode(linkDescription);
-  return sendPost("/v1/send_chat_link", token, body);
+bool WaavisClient::writeUpload(Client &client, const uint8_t *data, size_t len) {
+  while (len > 0) {
+    size_t piece = len < kUploadBufferSize ? len : kUploadBufferSize;
+    if (waitBudget(1) == 0 || !waavisWriteAll(client, data, piece) || !reportUpload(piece)) {
+      return false;
+    }
+    data += piece;
+    len -= piece;
+  }
+  return true;
 }
 
+#if WAAVIS_ENABLE_MEDIA
 bool WaavisClient::sendChatMedia(const String &token, const String &to,
                                  const String &message, bool typing,
                                  const String &type, Stream &file,
                                  size_t fileSize, const String &fileName) {
+  WAAVIS_IO_LOCK();
   return sendChatMediaStream(token, to, message, typing, type, file, fileSize, fileName);
 }
 
 bool WaavisClient::sendChatMediaFromUrl(const String &token, const String &to,
                                         const String &caption, bool typing,
                                         const String &imageUrl) {
-  if (WiFi.status() != WL_CONNECTED) {
-    _lastError = "WiFi not connected";
-    return false;
-  }
+  WAAVIS_IO_LOCK();
+  WaavisForm form;
+  form.add("to", to);
+  form.add("caption", caption);
+  form.add("typing", typing ? "true" : "false");
+  form.add("type", "image_url");
+  form.add("image_url", imageUrl);
+  return sendOrQueue("POST", "/v1/send_chat_media", token, &form);
+}
+
+String waavisMediaToPart(const String &boundary, const String &to) {
+  return "--" + boundary + "\r\nContent-Disposition: form-data; name=\"to\"\r\n\r\n" +
+         to + "\r\n";
+}
 
-  String body = "to=" + urlEncode(to) +
-                "&caption=" + urlEncode(caption) +
-                "&typing=" + String(typing ? "true" : "false") +
-                "&type=image_url" +
-                "&image_url=" + urlEncode(imageUrl);
-  return sendPost("/v1/send_chat_media", token, body);
+// The multipart fields after "to", up to the start of the file data.
+String waavisMediaCommonParts(const String &boundary, const String &message,
+                               bool typing, const String &type,
+                               const String &fileName) {
+  String head = "--" + boundary + "\r\n";
+  head += "Content-Disposition: form-data; name=\"message\"\r\n\r\n" + message + "\r\n";
+  head += "--" + boundary + "\r\n";
+  head += "Content-Disposition: form-data; name=\"typing\"\r\n\r\n" +
+          String(typing ? "true" : "false") + "\r\n";
+  head += "--" + boundary + "\r\n";
+  head += "Content-Disposition: form-data; name=\"type\"\r\n\r\n" + type + "\r\n";
+  head += "--" + boundary + "\r\n";
+  head += "Content-Disposition: form-data; name=\"file\"; filename=\"" +
+          fileName + "\"\r\n";
+  head += "Content-Type: application/octet-stream\r\n\r\n";
+  return head;
 }
 
 bool WaavisClient::sendChatMediaBuffer(const String &token, const String &to,
                                        const String &message, bool typing,
                                        const String &type, const uint8_t *data,
                                        size_t dataSize, const String &fileName) {
-  if (WiFi.status() != WL_CONNECTED) {
+  WAAVIS_IO_LOCK();
+  if (!linkUp()) {
     _lastError = "WiFi not connected";
     return false;
   }
@@ -170,511 +1259,325 @@ bool WaavisClient::sendChatMediaBuffer(const String &token, const String &to,
   }
 
   String boundary = "----WaavisBoundary" + String(millis());
-  String head = "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"to\"\r\n\r\n" + to + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"message\"\r\n\r\n" + message + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"typing\"\r\n\r\n" +
-          String(typing ? "true" : "false") + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"type\"\r\n\r\n" + type + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"file\"; filename=\"" +
-          fileName + "\"\r\n";
-  head += "Content-Type: application/octet-stream\r\n\r\n";
-
+  String head = waavisMediaToPart(boundary, to) +
+                waavisMediaCommonParts(boundary, message, typing, type, fileName);
   String tail = "\r\n--" + boundary + "--\r\n";
-  size_t contentLength = head.length() + dataSize + tail.length();
+  // The body goes out as three slices written straight from head, the
+  // caller's buffer and tail; nothing is copied.
+  return sendRequest("POST", "/v1/send_chat_media", token,
+                     "multipart/form-data; boundary=" + boundary, head, data,
+                     dataSize, tail);
+}
 
-#if defined(ESP8266)
-  BearSSL::WiFiClientSecure client;
-  if (_sslCert != nullptr) {
-    BearSSL::X509List cert(_sslCert);
-    client.setTrustAnchors(&cert);
-  } else if (_insecure) {
-    client.setInsecure();
+size_t WaavisClient::sendChatMediaBufferBatch(const String &token,
+                                              const String recipients[], size_t count,
+                                              const String &message, bool typing,
+                                              const String &type, const uint8_t *data,
+                                              size_t dataSize, const String &fileName,
+                                              bool *results) {
+  WAAVIS_IO_LOCK();
+  for (size_t i = 0; results != nullptr && i < count; ++i) {
+    results[i] = false;
   }
-  HTTPClient http;
-  if (!http.begin(client, _baseUrl + "/v1/send_chat_media")) {
-    _lastError = "HTTP begin failed";
-    return false;
+  if (stepBusy()) {
+    return 0;
   }
-#elif defined(ESP32)
-  WiFiClientSecure client;
-  if (_sslCert != nullptr) {
-    client.setCACert(_sslCert);
-  } else if (_insecure) {
-    client.setInsecure();
+  if (!linkUp()) {
+    _lastError = "WiFi not connected";
+    return 0;
   }
-  HTTPClient http;
-  if (!http.begin(client, _baseUrl + "/v1/send_chat_media")) {
-    _lastError = "HTTP begin failed";
-    return false;
+  if (dataSize == 0) {
+    _lastError = "File is empty";
+    return 0;
   }
-#endif
-
-  http.addHeader("Authorization", token);
-  http.addHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
-
-  class MultipartStream : public Stream {
-  public:
-    MultipartStream(const String &head, const uint8_t *data, size_t dataSize,
-                    const String &tail)
-        : _head(head), _data(data), _dataSize(dataSize), _tail(tail),
-          _headPos(0), _dataPos(0), _tailPos(0) {}
-
-    int available() override {
-      return static_cast<int>((_head.length() - _headPos) +
-                              (_dataSize - _dataPos) +
-                              (_tail.length() - _tailPos));
-    }
-
-    int read() override {
-      if (_headPos < _head.length()) {
-        return _head[_headPos++];
-      }
-      if (_dataPos < _dataSize) {
-        return _data[_dataPos++];
-      }
-      if (_tailPos < _tail.length()) {
-        return _tail[_tailPos++];
-      }
-      return -1;
-    }
 
-    int peek() override {
-      return -1;
-    }
-
-    size_t write(uint8_t) override {
-      return 0;
+  String boundary = "----WaavisBoundary" + String(millis());
+  String common = waavisMediaCommonParts(boundary, message, typing, type, fileName);
+  String tail = "\r\n--" + boundary + "--\r\n";
+  String contentType = "multipart/form-data; boundary=" + boundary;
+  String lastFailure;
+  size_t sent = 0;
+  for (size_t i = 0; i < count; ++i) {
+    // The requests share the keep-alive connection; a failed one does not
+    // stop the rest.
+    String head = waavisMediaToPart(boundary, recipients[i]);
+    head += common;
+    bool ok = sendRequest("POST", "/v1/send_chat_media", token, contentType, head,
+                          data, dataSize, tail);
+    if (results != nullptr) {
+      results[i] = ok;
     }
-
-  private:
-    const String &_head;
-    const uint8_t *_data;
-    size_t _dataSize;
-    const String &_tail;
-    size_t _headPos;
-    size_t _dataPos;
-    size_t _tailPos;
-  };
-
-  MultipartStream body(head, data, dataSize, tail);
-  int httpCode = http.sendRequest("POST", &body, contentLength);
-  if (httpCode <= 0) {
-    _lastError = http.errorToString(httpCode);
-    http.end();
-    return false;
-  }
-
-  if (httpCode < 200 || httpCode >= 300) {
-    String response = http.getString();
-    WAAVIS_LOG("[waavis] response: " + response);
-    
-    // Extract error from JSON
-    int errorIdx = response.indexOf("\"error\":");
-    if (errorIdx >= 0) {
-      int startQuote = response.indexOf('"', errorIdx + 8);
-      int endQuote = response.indexOf('"', startQuote + 1);
-      if (startQuote >= 0 && endQuote > startQuote) {
-        _lastError = response.substring(startQuote + 1, endQuote);
-      } else {
-        _lastError = "HTTP " + String(httpCode);
-      }
+    if (ok) {
+      ++sent;
     } else {
-      _lastError = "HTTP " + String(httpCode);
+      lastFailure = _lastError;
     }
-    http.end();
-    return false;
   }
-
-  _lastError = "";
-  http.end();
-  return true;
+  _lastError = sent == count ? "" : lastFailure;
+  return sent;
 }
 
-bool WaavisClient::sendChatMediaStream(const String &token, const String &to,
-                                       const String &message, bool typing,
-                                       const String &type, Stream &file,
-                                       size_t fileSize, const String &fileName) {
+size_t WaavisClient::sendChatMediaBatch(const String &token, const String recipients[],
+                                        size_t count, const String &message,
+                                        bool typing, const String &type, Stream &file,
+                                        size_t fileSize, const String &fileName,
+                                        bool *results) {
+  WAAVIS_IO_LOCK();
+  for (size_t i = 0; results != nullptr && i < count; ++i) {
+    results[i] = false;
+  }
+  if (stepBusy()) {
+    return 0;
+  }
   if (fileSize == 0) {
     _lastError = "File is empty";
-    return false;
+    return 0;
+  }
+  if (fileSize == WAAVIS_UNKNOWN_SIZE) {
+    _lastError = "File size required";
+    return 0;
   }
 
 #if defined(ESP32)
-  // Use chunked upload on ESP32 to avoid large RAM allocations.
-  return sendChatMediaStreamChunked(token, to, message, typing, type, file, fileName);
-#else
-  // For external stream, we need to read into buffer first
-  if (fileSize > 102400) {
-    _lastError = "File too large (max 100KB for stream)";
-    return false;
+  uint8_t *payload = static_cast<uint8_t *>(
+      heap_caps_malloc(fileSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+  if (payload == nullptr) {
+    payload = static_cast<uint8_t *>(malloc(fileSize));
   }
-  
-  uint8_t *buffer = (uint8_t *)malloc(fileSize);
-  if (buffer == nullptr) {
+#else
+  uint8_t *payload = static_cast<uint8_t *>(malloc(fileSize));
+#endif
+  if (payload == nullptr) {
     _lastError = "Out of memory";
-    return false;
+    return 0;
   }
-  
-  size_t totalRead = 0;
-  while (totalRead < fileSize && file.available()) {
-    size_t remaining = fileSize - totalRead;
-    size_t toRead = remaining > 1024 ? 1024 : remaining;
-    size_t readBytes = file.readBytes((char *)(buffer + totalRead), toRead);
-    if (readBytes == 0) {
+
+  size_t received = 0;
+  unsigned long lastRead = millis();
+  while (received < fileSize) {
+    size_t n = file.readBytes(reinterpret_cast<char *>(payload + received),
+                              fileSize - received);
+    if (n > 0) {
+      received += n;
+      lastRead = millis();
+    } else if (millis() - lastRead > _streamIdleTimeout) {
       break;
+    } else {
+      delay(1);
     }
-    totalRead += readBytes;
   }
-  
-  bool ok = false;
-  if (totalRead == fileSize) {
-    ok = sendChatMediaBuffer(token, to, message, typing, type, buffer, totalRead, fileName);
-  } else {
+
+  size_t sent = 0;
+  if (received < fileSize) {
     _lastError = "Incomplete read";
+  } else {
+    sent = sendChatMediaBufferBatch(token, recipients, count, message, typing, type,
+                                    payload, fileSize, fileName, results);
   }
-  
-  free(buffer);
-  return ok;
-#endif
+  free(payload);
+  return sent;
 }
 
-static String parseHost(const String &url, bool &isHttps, uint16_t &port) {
-  String lower = url;
-  lower.toLowerCase();
-  isHttps = lower.startsWith("https://");
-  bool isHttp = lower.startsWith("http://");
-  if (!isHttps && !isHttp) {
-    return "";
-  }
-
-  int start = isHttps ? 8 : 7;
-  int slash = url.indexOf('/', start);
-  String hostPort = (slash >= 0) ? url.substring(start, slash) : url.substring(start);
-  int colon = hostPort.indexOf(':');
-  if (colon >= 0) {
-    port = static_cast<uint16_t>(hostPort.substring(colon + 1).toInt());
-    return hostPort.substring(0, colon);
+bool WaavisClient::sendChatMediaStream(const String &token, const String &to,
+                                       const String &message, bool typing,
+                                       const String &type, Stream &file,
+                                       size_t fileSize, const String &fileName) {
+  if (fileSize == 0) {
+    _lastError = "File is empty";
+    return false;
   }
 
-  port = isHttps ? 443 : 80;
-  return hostPort;
+  // The file goes out in small pieces as it is read, so RAM use does not
+  // depend on its size.
+  return sendChatMediaStreamChunked(token, to, message, typing, type, file,
+                                    fileSize, fileName);
 }
 
-static void writeChunk(Stream &client, const uint8_t *data, size_t len) {
+static bool writeChunk(Client &client, const uint8_t *data, size_t len) {
   if (len == 0) {
-    return;
+    return true;
   }
-  String hex = String(len, HEX);
-  hex.toUpperCase();
-  client.print(hex);
-  client.print("\r\n");
-  client.write(data, len);
-  client.print("\r\n");
+  char size[12];
+  snprintf(size, sizeof(size), "%X\r\n", static_cast<unsigned int>(len));
+  return waavisWriteAll(client, reinterpret_cast<const uint8_t *>(size), strlen(size)) &&
+         waavisWriteAll(client, data, len) &&
+         waavisWriteAll(client, reinterpret_cast<const uint8_t *>("\r\n"), 2);
 }
 
+// Streams file as the multipart file part. With a known fileSize the body is
+// sent with Content-Length and ends after exactly fileSize bytes; with
+// WAAVIS_UNKNOWN_SIZE it is sent chunked and ends once file has produced no
+// data for the stream idle timeout.
+// sourceDone, if given, is set once file will produce no more data; the
+// upload then ends as soon as file is drained instead of after the idle
+// timeout.
 bool WaavisClient::sendChatMediaStreamChunked(const String &token, const String &to,
                                               const String &message, bool typing,
                                               const String &type, Stream &file,
-                                              const String &fileName) {
-  WAAVIS_LOG("[waavis] chunked upload start");
-  if (WiFi.status() != WL_CONNECTED) {
-    _lastError = "WiFi not connected";
-    WAAVIS_LOG("[waavis] WiFi not connected");
+                                              size_t fileSize,
+                                              const String &fileName,
+                                              const volatile bool *sourceDone) {
+  bool chunked = fileSize == WAAVIS_UNKNOWN_SIZE;
+  WAAVIS_TRACE(INFO, UploadStart, chunked ? -1 : static_cast<int32_t>(fileSize));
+  if (stepBusy()) {
     return false;
   }
-
-  bool isHttps = false;
-  uint16_t port = 0;
-  String host = parseHost(_baseUrl, isHttps, port);
-  if (host.length() == 0) {
-    _lastError = "Invalid base URL";
-    WAAVIS_LOG("[waavis] Invalid base URL");
+  if (!linkUp()) {
+    _lastError = "WiFi not connected";
+    WAAVIS_TRACE(ERROR, WiFiDown, 0);
     return false;
   }
 
   String boundary = "----WaavisBoundary" + String(millis());
-  String head = "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"to\"\r\n\r\n" + to + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"message\"\r\n\r\n" + message + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"typing\"\r\n\r\n" +
-          String(typing ? "true" : "false") + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"type\"\r\n\r\n" + type + "\r\n";
-  head += "--" + boundary + "\r\n";
-  head += "Content-Disposition: form-data; name=\"file\"; filename=\"" +
-          fileName + "\"\r\n";
-  head += "Content-Type: application/octet-stream\r\n\r\n";
-
+  String head = waavisMediaToPart(boundary, to) +
+                waavisMediaCommonParts(boundary, message, typing, type, fileName);
   String tail = "\r\n--" + boundary + "--\r\n";
 
-#if defined(ESP8266)
-  BearSSL::WiFiClientSecure secureClient;
-  WiFiClient plainClient;
-  Stream *client = nullptr;
-  if (isHttps) {
-    if (_sslCert != nullptr) {
-      BearSSL::X509List cert(_sslCert);
-      secureClient.setTrustAnchors(&cert);
-    } else if (_insecure) {
-      secureClient.setInsecure();
-    }
-    if (!secureClient.connect(host.c_str(), port)) {
-      _lastError = "HTTP connect failed";
-      WAAVIS_LOG("[waavis] HTTPS connect failed");
+  timingBegin();
+  long contentLength = chunked ? -1
+                               : static_cast<long>(head.length() + fileSize + tail.length());
+  // Nothing is read from the stream before the multipart head is out, so a
+  // reused connection the server closed while idle is replaced once, as in
+  // sendRequest().
+  Client *client = nullptr;
+  bool ok = false;
+  for (int attempt = 0; attempt < 2 && !ok; ++attempt) {
+    bool reused = false;
+    client = openConnection(reused);
+    if (client == nullptr) {
+      timingEnd(WaavisEndpoint::SendChatMedia, false);
       return false;
     }
-    client = &secureClient;
-  } else {
-    if (!plainClient.connect(host.c_str(), port)) {
-      _lastError = "HTTP connect failed";
-      WAAVIS_LOG("[waavis] HTTP connect failed");
-      return false;
+    ok = writeRequestHead(*client, "POST", "/v1/send_chat_media", token,
+                          "multipart/form-data; boundary=" + boundary, contentLength);
+    if (ok) {
+      markPhase(WaavisPhase::HeadersSent);
+      beginUpload(fileSize);
+      WAAVIS_TRACE(VERBOSE, HeadersSent, 0);
+      ok = chunked ? writeChunk(*client, reinterpret_cast<const uint8_t *>(head.c_str()),
+                                head.length())
+                   : waavisWriteAll(*client, head);
     }
-    client = &plainClient;
-  }
-#elif defined(ESP32)
-  WiFiClientSecure secureClient;
-  WiFiClient plainClient;
-  Stream *client = nullptr;
-  if (isHttps) {
-    if (_sslCert != nullptr) {
-      secureClient.setCACert(_sslCert);
-    } else if (_insecure) {
-      secureClient.setInsecure();
-    }
-    if (!secureClient.connect(host.c_str(), port)) {
-      _lastError = "HTTP connect failed";
-      WAAVIS_LOG("[waavis] HTTPS connect failed");
-      return false;
+    if (ok) {
+      break;
     }
-    client = &secureClient;
-  } else {
-    if (!plainClient.connect(host.c_str(), port)) {
-      _lastError = "HTTP connect failed";
-      WAAVIS_LOG("[waavis] HTTP connect failed");
+    bool closed = !client->connected();
+    stop();
+    if (timedOut()) {
+      timingEnd(WaavisEndpoint::SendChatMedia, false);
       return false;
     }
-    client = &plainClient;
+    if (!reused || !closed) {
+      break;
+    }
+    WAAVIS_TRACE(INFO, StaleConnection, 0);
+  }
+  if (!ok) {
+    _lastError = "HTTP connection lost";
+    timingEnd(WaavisEndpoint::SendChatMedia, false);
+    return false;
   }
-#endif
-
-  client->print("POST /v1/send_chat_media HTTP/1.1\r\n");
-  client->print("Host: ");
-  client->print(host);
-  client->print("\r\n");
-  client->print("Authorization: ");
-  client->print(token);
-  client->print("\r\n");
-  client->print("Content-Type: multipart/form-data; boundary=");
-  client->print(boundary);
-  client->print("\r\n");
-  client->print("Transfer-Encoding: chunked\r\n");
-  client->print("Connection: close\r\n\r\n");
-  WAAVIS_LOG("[waavis] headers sent");
-
-  writeChunk(*client, reinterpret_cast<const uint8_t *>(head.c_str()), head.length());
 
-  uint8_t buffer[1024];
+  uint8_t buffer[kUploadBufferSize];
+  size_t remaining = fileSize;
   unsigned long lastRead = millis();
-  while (true) {
+  while (ok && remaining > 0) {
+    if (waitBudget(1) == 0) {
+      ok = false;
+      break;
+    }
     int available = file.available();
     if (available > 0) {
       size_t toRead = static_cast<size_t>(available);
       if (toRead > sizeof(buffer)) {
         toRead = sizeof(buffer);
       }
+      if (toRead > remaining) {
+        toRead = remaining;
+      }
       size_t readBytes = file.readBytes(reinterpret_cast<char *>(buffer), toRead);
       if (readBytes > 0) {
-        writeChunk(*client, buffer, readBytes);
+        ok = (chunked ? writeChunk(*client, buffer, readBytes)
+                      : waavisWriteAll(*client, buffer, readBytes)) &&
+             reportUpload(readBytes);
+        if (!chunked) {
+          remaining -= readBytes;
+        }
         lastRead = millis();
       }
       continue;
     }
 
-    if (millis() - lastRead > 5000) {
+    // Read the flag before re-checking available(): the producer sets it only
+    // after its last byte is buffered.
+    bool drained = sourceDone != nullptr && *sourceDone && file.available() <= 0;
+    if (drained || millis() - lastRead > _streamIdleTimeout) {
+      if (!chunked) {
+        // The announced length cannot be met; the connection is unusable.
+        stop();
+        _lastError = "Incomplete read";
+        timingEnd(WaavisEndpoint::SendChatMedia, false);
+        return false;
+      }
       break;
     }
-    delay(10);
+    delay(chunked ? 10 : 1);
   }
 
-  writeChunk(*client, reinterpret_cast<const uint8_t *>(tail.c_str()), tail.length());
-  client->print("0\r\n\r\n");
-  WAAVIS_LOG("[waavis] body sent");
-
-  String statusLine = client->readStringUntil('\n');
-  int status = -1;
-  if (statusLine.startsWith("HTTP/")) {
-    int firstSpace = statusLine.indexOf(' ');
-    if (firstSpace >= 0 && firstSpace + 3 < static_cast<int>(statusLine.length())) {
-      status = statusLine.substring(firstSpace + 1, firstSpace + 4).toInt();
-    }
-  }
-  
-  // Skip headers to get to body
-  while (client->available()) {
-    String headerLine = client->readStringUntil('\n');
-    if (headerLine == "\r" || headerLine.length() == 0) {
-      break; // End of headers
-    }
-  }
-  
-  // Read response body
-  String responseBody = "";
-  unsigned long bodyStart = millis();
-  while (client->available() && millis() - bodyStart < 3000) {
-    if (client->available()) {
-      responseBody += (char)client->read();
-    } else {
-      delay(10);
-    }
-  }
-  
-  if (responseBody.length() > 0) {
-    WAAVIS_LOG("[waavis] response: " + responseBody);
-    
-    // Extract error message from JSON if present
-    int errorIdx = responseBody.indexOf("\"error\":");
-    if (errorIdx >= 0) {
-      int startQuote = responseBody.indexOf('"', errorIdx + 8);
-      int endQuote = responseBody.indexOf('"', startQuote + 1);
-      if (startQuote >= 0 && endQuote > startQuote) {
-        String errorMsg = responseBody.substring(startQuote + 1, endQuote);
-        _lastError = errorMsg;
-        WAAVIS_LOG("[waavis] error: " + errorMsg);
-      }
-    }
+  if (ok) {
+    ok = chunked ? writeChunk(*client, reinterpret_cast<const uint8_t *>(tail.c_str()),
+                              tail.length()) &&
+                       waavisWriteAll(*client, reinterpret_cast<const uint8_t *>("0\r\n\r\n"), 5)
+                 : waavisWriteAll(*client, tail);
   }
-
-  if (status < 200 || status >= 300) {
-    if (_lastError.length() == 0) {
-      _lastError = "HTTP " + String(status);
+  if (!ok) {
+    stop();
+    if (!timedOut()) {
+      _lastError = uploadCancelled() ? "Upload cancelled" : "HTTP connection lost";
     }
+    timingEnd(WaavisEndpoint::SendChatMedia, false);
     return false;
   }
+  markPhase(WaavisPhase::BodySent);
+  endUpload();
+  WAAVIS_TRACE(VERBOSE, BodySent, 0);
 
-  _lastError = "";
-  WAAVIS_LOG("[waavis] chunked upload ok");
-  return true;
-}
-
-bool WaavisClient::sendPost(const String &path, const String &token, const String &body) {
-  if (WiFi.status() != WL_CONNECTED) {
-    _lastError = "WiFi not connected";
-    return false;
-  }
-
-  String url = _baseUrl + path;
-
-#if defined(ESP8266)
-  BearSSL::WiFiClientSecure client;
-  if (_sslCert != nullptr) {
-    BearSSL::X509List cert(_sslCert);
-    client.setTrustAnchors(&cert);
-  } else if (_insecure) {
-    client.setInsecure();
-  }
-  HTTPClient http;
-  if (!http.begin(client, url)) {
-    _lastError = "HTTP begin failed";
-    return false;
-  }
-#elif defined(ESP32)
-  WiFiClientSecure client;
-  if (_sslCert != nullptr) {
-    client.setCACert(_sslCert);
-  } else if (_insecure) {
-    client.setInsecure();
-  }
-  HTTPClient http;
-  if (!http.begin(client, url)) {
-    _lastError = "HTTP begin failed";
-    return false;
-  }
-#endif
-
-  http.addHeader("Authorization", token);
-  http.addHeader("Content-Type", "application/x-www-form-urlencoded");
-
-  int httpCode = http.POST(body);
-  if (httpCode <= 0) {
-    _lastError = http.errorToString(httpCode);
-    http.end();
+  if (!readResponse(*client)) {
+    if (!timedOut()) {
+      _lastError = "HTTP connection lost";
+    }
+    timingEnd(WaavisEndpoint::SendChatMedia, false);
     return false;
   }
-
-  if (httpCode < 200 || httpCode >= 300) {
-    String response = http.getString();
-    WAAVIS_LOG("[waavis] response: " + response);
-    
-    // Extract error from JSON
-    int errorIdx = response.indexOf("\"error\":");
-    if (errorIdx >= 0) {
-      int startQuote = response.indexOf('"', errorIdx + 8);
-      int endQuote = response.indexOf('"', startQuote + 1);
-      if (startQuote >= 0 && endQuote > startQuote) {
-        _lastError = response.substring(startQuote + 1, endQuote);
-      } else {
-        _lastError = "HTTP " + String(httpCode);
-      }
-    } else {
-      _lastError = "HTTP " + String(httpCode);
-    }
-    http.end();
+  bool accepted = finishResponse();
+  timingEnd(WaavisEndpoint::SendChatMedia, accepted);
+  if (!accepted) {
     return false;
   }
-
-  _lastError = "";
-  http.end();
+  WAAVIS_TRACE(INFO, UploadDone, _uploadSent);
   return true;
 }
+#endif
 
-String WaavisClient::urlEncode(const String &value) const {
-  String encoded = "";
-  const char *hex = "0123456789ABCDEF";
-  for (size_t i = 0; i < value.length(); ++i) {
-    char c = value.charAt(i);
-    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
-        (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~') {
-      encoded += c;
-    } else if (c == ' ') {
-      encoded += "%20";
-    } else {
-      encoded += '%';
-      encoded += hex[(c >> 4) & 0x0F];
-      encoded += hex[c & 0x0F];
-    }
-  }
-  return encoded;
-}
-
+#if defined(ESP32) && WAAVIS_ENABLE_SPIFFS_LIST
 void WaavisClient::listSPIFFSFiles() {
-#if defined(ESP32)
   if (!SPIFFS.begin(true)) {
-    WAAVIS_LOG("[waavis] SPIFFS Mount Failed");
+    Serial.println("[waavis] SPIFFS Mount Failed");
     return;
   }
-  WAAVIS_LOG("[waavis] Listing SPIFFS files:");
+  Serial.println("[waavis] Listing SPIFFS files:");
   File root = SPIFFS.open("/");
   if(!root){
-      WAAVIS_LOG("[waavis] Failed to open root directory");
+      Serial.println("[waavis] Failed to open root directory");
       return;
   }
   File file = root.openNextFile();
   while(file){
       String fileName = file.name();
       size_t fileSize = file.size();
-      WAAVIS_LOG("  FILE: " + fileName + "  SIZE: " + String(fileSize));
+      Serial.println("  FILE: " + fileName + "  SIZE: " + String(fileSize));
       file = root.openNextFile();
   }
-  WAAVIS_LOG("[waavis] End of list");
-#else
-  WAAVIS_LOG("[waavis] listSPIFFSFiles only supported on ESP32 in this version");
-#endif
+  Serial.println("[waavis] End of list");
 }
+#endif
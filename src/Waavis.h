@@ -2,28 +2,362 @@
 #define WAAVIS_H
 
 #include <Arduino.h>
+#include "WaavisConfig.h"
+#include "WaavisTemplate.h"
+#include "WaavisTrace.h"
+#include <initializer_list>
+#if WAAVIS_ENABLE_OUTBOX
+#include <FS.h>
+#endif
+
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#if WAAVIS_ENABLE_TLS
+#include <WiFiClientSecureBearSSL.h>
+#endif
+#elif defined(ESP32)
+#include <WiFi.h>
+#if WAAVIS_ENABLE_TLS
+#include <WiFiClientSecure.h>
+#endif
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#elif defined(WAAVIS_HOST)
+// Linux build against the Arduino shim in extras/host; its WiFiClientSecure
+// is OpenSSL behind the ESP32 API.
+#include <WiFi.h>
+#if WAAVIS_ENABLE_TLS
+#include <WiFiClientSecure.h>
+#endif
+#else
+#error "Waavis library supports ESP8266 and ESP32 only."
+#endif
+
+// Pass as fileSize to sendChatMedia when the stream length is not known in
+// advance; the upload then uses chunked transfer encoding.
+static const size_t WAAVIS_UNKNOWN_SIZE = static_cast<size_t>(-1);
+
+// Outcome of the last request, filled while the response streams in.
+// Fields are empty strings when the server did not send them.
+struct WaavisResponse {
+  int status;  // HTTP status, -1 if no response was received
+  char messageId[40];
+  char errorCode[24];
+  char error[96];
+};
+
+enum class WaavisEndpoint : uint8_t { SendChat, SendChatLink, SendChatMedia };
+static const size_t WAAVIS_ENDPOINT_COUNT = 3;
+
+// Phase boundaries of one request. Connect is the end of the TCP connect and
+// Handshake the end of TLS; both cores do the two inside connect(), so they
+// coincide. Phases a request skipped (e.g. connecting on a reused
+// connection) stay 0.
+enum class WaavisPhase : uint8_t {
+  Resolve,
+  Connect,
+  Handshake,
+  HeadersSent,
+  BodySent,
+  FirstByte,
+  Done
+};
+static const size_t WAAVIS_PHASE_COUNT = 7;
+
+struct WaavisTiming {
+  uint32_t at[WAAVIS_PHASE_COUNT];  // microseconds since the call started
+  bool reused;                      // ran on an already open connection
+};
+
+// Bucket i counts calls that took less than 16 << i ms; the last bucket
+// holds everything slower.
+static const size_t WAAVIS_HISTOGRAM_BUCKETS = 12;
+
+struct WaavisEndpointStats {
+  uint32_t count;
+  uint32_t failures;
+  uint32_t maxMs;
+  uint32_t phaseTotalMs[WAAVIS_PHASE_COUNT];  // time spent ending in each phase
+  uint32_t histogram[WAAVIS_HISTOGRAM_BUCKETS];
+};
+
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+// Heap use of the last call. Minimums are sampled at every phase boundary
+// and upload piece, so a short spike between samples can be missed.
+struct WaavisMemoryProfile {
+  uint32_t freeBefore;
+  uint32_t freeAfter;
+  uint32_t freeMin;
+  uint32_t largestBefore;  // largest free block
+  uint32_t largestAfter;
+  uint32_t largestMin;
+  int32_t blocksDelta;  // heap blocks still allocated after the call (ESP32; 0 on ESP8266)
+};
+#endif
+
+// Times are millis() since boot, which after a deep-sleep wake is the time
+// since wake minus the ROM boot.
+struct WaavisWakeReport {
+  bool active;               // resumeWiFi() was called
+  bool fastWiFi;             // joined with the saved BSSID, channel and IP
+  bool serverIpRestored;     // DNS was skipped
+  bool tlsSessionRestored;   // BearSSL session offered for resumption (ESP8266)
+  uint32_t wifiMs;           // WiFi connected
+  uint32_t ackMs;            // first send acknowledged by the server, 0 if none
+};
+
+// Called while a media upload runs with the media bytes sent so far, the
+// total (WAAVIS_UNKNOWN_SIZE for chunked uploads) and the average rate since
+// the upload started. Returning false cancels the upload.
+typedef bool (*WaavisProgressCallback)(size_t sent, size_t total,
+                                       uint32_t bytesPerSecond, void *arg);
+
+// poll() result for the step-based send API.
+enum class WaavisPollResult : uint8_t { Idle, InProgress, Done, Failed };
+
+#if defined(ESP32)
+enum class WaavisPriority : uint8_t { High, Normal };
+
+enum class WaavisSendStatus : uint8_t { Unknown, Queued, Running, Done, Failed };
+
+// Called on the worker task when an asynchronous send finishes.
+typedef void (*WaavisSendCallback)(uint32_t ticket, bool ok,
+                                   const String &error, void *arg);
+#endif
+
+class WaavisForm;
+class WaavisJsonScanner;
 
 class WaavisClient {
 public:
   explicit WaavisClient(const String &baseUrl = "https://api.waavis.com");
+  ~WaavisClient();
   void setInsecure(bool insecure);
-  void setCertificate(const char* cert);
+  // Verifies the server against the CA certificate(s) in cert (PEM); cert
+  // must stay valid. nullptr or "" turns verification off. Returns false and
+  // keeps the previous setting if cert holds no certificate.
+  bool setCertificate(const char* cert);
+#if WAAVIS_ENABLE_TLS
+  // Pins the server certificate by its hex fingerprint (":" or " " between
+  // bytes allowed): SHA-1 on ESP8266, SHA-256 elsewhere. The chain is then not
+  // verified; a connection is accepted only if the hash matches. nullptr
+  // clears the pin.
+  bool setFingerprint(const char *fingerprint);
+#if defined(ESP8266)
+  // Pins the server's public key (PEM); survives certificate renewals that
+  // keep the key.
+  bool setPublicKey(const char *pem);
+#endif
+#endif
+  // Keep the connection to the API open between calls (default on). An idle
+  // connection older than idleTimeoutMs is closed and reopened on next use.
+  void setKeepAlive(bool keepAlive);
+  void setIdleTimeout(unsigned long idleTimeoutMs);
+  // Upper bound for each send from DNS to the last response byte (0, the
+  // default, disables it). When it runs out the call fails with the phase
+  // that was cut short: "DNS timeout", "Connect timeout", "Upload timeout"
+  // or "Response timeout". The TLS handshake counts as connect.
+  void setDeadline(unsigned long deadlineMs);
+  // Sends through client instead of the built-in WiFi clients, e.g. an
+  // Ethernet or modem client, or a TLS wrapper around one. The client does
+  // its own DNS and TLS; it is connected by host name and port from the base
+  // URL, and the WiFi checks are skipped. nullptr goes back to WiFi.
+  // nonBlocking is for a client whose connect() may return before the
+  // connection and its TLS handshake are up and whose availableForWrite()
+  // says how much write() takes without waiting (0 until connected). The
+  // step sends then write only that much and otherwise wait in poll(), so
+  // connecting, the handshake and the upload never block; DNS inside
+  // connect() still does.
+  void setTransport(Client *client, bool nonBlocking = false);
+  void stop();
+  // TLS handshakes that resumed a cached session vs. full handshakes. Session
+  // resumption needs BearSSL (ESP8266); on ESP32 every handshake is full.
+  uint32_t tlsSessionHits() const;
+  uint32_t tlsSessionMisses() const;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  // TLS record size to negotiate with the server (512, 1024, 2048 or 4096;
+  // default 512). Shrinks BearSSL's buffers from ~17 KB to twice this size
+  // when the server supports it. 0 keeps the full-size buffers.
+  void setTlsFragmentLength(uint16_t length);
+#endif
   bool sendChat(const String &token, const String &to, const String &message);
   bool sendChatPost(const String &token, const String &to, const String &message,
                     bool typing = false);
+  // Like sendChatPost with message rendered from a template straight into
+  // the request body: values fill its fields in order, e.g.
+  //   sendChatTemplate(token, to, tankAlert, {id, level, time})
+  bool sendChatTemplate(const String &token, const String &to,
+                        const WaavisTemplate &message,
+                        std::initializer_list<WaavisValue> values,
+                        bool typing = false);
+  // Sends the same message to count recipients over one connection and returns
+  // how many succeeded; results, if given, receives one flag per recipient.
+  // With a pipeline depth above 1, up to depth requests are written before
+  // their responses are read (only enable it if the server handles
+  // pipelined POSTs); the batch falls back to one at a time if the server
+  // closes the connection mid-window. The whole batch is one send for
+  // setDeadline(), lastTiming() and stats(); it fails there unless every
+  // recipient succeeded.
+  size_t sendChatBatch(const String &token, const String recipients[],
+                       size_t count, const String &message, bool typing = false,
+                       bool *results = nullptr);
+  void setPipelineDepth(uint8_t depth);
+#if WAAVIS_ENABLE_LINK
   bool sendChatLink(const String &token, const String &to, const String &message,
                     bool typing, const String &link, const String &linkTitle,
                     const String &linkDescription);
+#endif
+#if WAAVIS_ENABLE_MEDIA
   bool sendChatMedia(const String &token, const String &to, const String &message,
                      bool typing, const String &type, Stream &file,
                      size_t fileSize, const String &fileName);
+  // Sends dataSize bytes straight from data (RAM or PSRAM, e.g. a camera
+  // frame buffer) without copying them.
+  bool sendChatMediaBuffer(const String &token, const String &to,
+                           const String &message, bool typing,
+                           const String &type, const uint8_t *data,
+                           size_t dataSize, const String &fileName);
+  // Sends one file to count recipients over one connection and returns how
+  // many succeeded; results, if given, receives one flag per recipient. The
+  // file is read once into a buffer (PSRAM when present), so a stream that
+  // cannot be rewound works; fileSize must be known. Per recipient only the
+  // "to" part of the multipart body is rebuilt.
+  size_t sendChatMediaBatch(const String &token, const String recipients[],
+                            size_t count, const String &message, bool typing,
+                            const String &type, Stream &file, size_t fileSize,
+                            const String &fileName, bool *results = nullptr);
+  // Same from a caller-owned buffer, which is sent as-is without copying.
+  size_t sendChatMediaBufferBatch(const String &token, const String recipients[],
+                                  size_t count, const String &message,
+                                  bool typing, const String &type,
+                                  const uint8_t *data, size_t dataSize,
+                                  const String &fileName, bool *results = nullptr);
+  // The server fetches imageUrl itself.
   bool sendChatMediaFromUrl(const String &token, const String &to,
                             const String &caption, bool typing,
                             const String &imageUrl);
+  // Relay: the device downloads sourceUrl (e.g. a LAN camera the server
+  // cannot reach) and uploads it as the file while the download is still
+  // running, through a bounded buffer; the file is never held in RAM whole.
+  // The download always goes over WiFi, even with setTransport(). The
+  // deadline covers the download and the upload together.
+  bool sendChatMediaFromUrl(const String &token, const String &to,
+                            const String &caption, bool typing,
+                            const String &type, const String &sourceUrl);
+  // How long a media Stream may go without producing data before the upload
+  // gives up (known size) or ends the body (WAAVIS_UNKNOWN_SIZE).
+  void setStreamIdleTimeout(unsigned long idleTimeoutMs);
+  void onUploadProgress(WaavisProgressCallback callback, void *arg = nullptr);
+  // Moving average of the rate achieved by completed media uploads, in
+  // bytes per second; 0 before the first upload.
+  uint32_t uplinkBandwidth() const;
+#endif
 #if defined(ESP32)
+  // Starts the worker task that drains the *Async queue. queueLength bounds
+  // both the number of pending jobs and the number of results kept for
+  // sendStatus(). The worker runs on the core opposite to the caller. The
+  // destructor waits for a send the worker has started; queued jobs are
+  // dropped.
+  bool beginAsync(uint8_t queueLength = 8, uint32_t stackSize = 8192,
+                  UBaseType_t taskPriority = 1);
+  void onSendComplete(WaavisSendCallback callback, void *arg = nullptr);
+  // Each *Async call returns a ticket, or 0 if the queue is full or
+  // beginAsync() was not called. Strings are copied; a media Stream must stay
+  // valid until the job completes.
+  uint32_t sendChatAsync(const String &token, const String &to,
+                         const String &message,
+                         WaavisPriority priority = WaavisPriority::Normal);
+  uint32_t sendChatPostAsync(const String &token, const String &to,
+                             const String &message, bool typing = false,
+                             WaavisPriority priority = WaavisPriority::Normal);
+#if WAAVIS_ENABLE_LINK
+  uint32_t sendChatLinkAsync(const String &token, const String &to,
+                             const String &message, bool typing,
+                             const String &link, const String &linkTitle,
+                             const String &linkDescription,
+                             WaavisPriority priority = WaavisPriority::Normal);
+#endif
+#if WAAVIS_ENABLE_MEDIA
+  uint32_t sendChatMediaAsync(const String &token, const String &to,
+                              const String &message, bool typing,
+                              const String &type, Stream &file,
+                              size_t fileSize, const String &fileName,
+                              WaavisPriority priority = WaavisPriority::Normal);
+  // data is not copied and must stay valid until the job completes.
+  uint32_t sendChatMediaBufferAsync(const String &token, const String &to,
+                                    const String &message, bool typing,
+                                    const String &type, const uint8_t *data,
+                                    size_t dataSize, const String &fileName,
+                                    WaavisPriority priority = WaavisPriority::Normal);
+  uint32_t sendChatMediaFromUrlAsync(const String &token, const String &to,
+                                     const String &caption, bool typing,
+                                     const String &imageUrl,
+                                     WaavisPriority priority = WaavisPriority::Normal);
+#endif
+  WaavisSendStatus sendStatus(uint32_t ticket);
+  String sendError(uint32_t ticket);
+#if WAAVIS_ENABLE_SPIFFS_LIST
   void listSPIFFSFiles();
 #endif
+#endif
+  // Step-based sends for a single loop() (ESP8266): begin*() prepares the
+  // request and poll() advances it, returning after roughly budgetMs with
+  // InProgress until the send ends with Done or Failed (then lastError() and
+  // lastResponse() are set as for the blocking calls). One send at a time;
+  // the caller's values are copied, but data and file must stay valid until
+  // it ends. Opening a new connection (DNS, connect, TLS handshake) cannot be
+  // split and runs within one poll(); a kept-alive connection skips it.
+  // begin*() fails with "Send in progress" while an async send is running,
+  // and the blocking sends fail the same way until this send ends;
+  // processOutbox() waits for it.
+  bool beginChatPost(const String &token, const String &to, const String &message,
+                     bool typing = false);
+#if WAAVIS_ENABLE_MEDIA
+  bool beginChatMediaBuffer(const String &token, const String &to,
+                            const String &message, bool typing,
+                            const String &type, const uint8_t *data,
+                            size_t dataSize, const String &fileName);
+  // fileSize must be known.
+  bool beginChatMedia(const String &token, const String &to, const String &message,
+                      bool typing, const String &type, Stream &file,
+                      size_t fileSize, const String &fileName);
+#endif
+  WaavisPollResult poll(unsigned long budgetMs = 10);
+  void cancel();
+  bool sendInProgress() const;
+#if WAAVIS_ENABLE_OUTBOX
+  // Journal text sends that cannot reach the server (WiFi down, connect
+  // failure) in an append-only file on fs and deliver them from
+  // processOutbox(). A journaled send returns true. Records are staged in RAM
+  // and written in batches; flushOutbox() forces the write, e.g. before sleep.
+  bool beginOutbox(fs::FS &fs, const char *path = "/waavis_outbox.log");
+  void processOutbox();
+  void flushOutbox();
+  size_t outboxPending() const;
+#endif
+  // Deep-sleep fast path: call resumeWiFi() instead of WiFi.begin() after
+  // waking and saveResumeState() right before sleeping. The saved BSSID,
+  // channel, IP lease, server address and (ESP8266) TLS session are kept in
+  // RTC memory; on ESP8266 they take 128 bytes of the RTC user area starting
+  // at block rtcSlot. Falls back to a normal join if the saved state fails.
+  bool resumeWiFi(const char *ssid, const char *password,
+                  unsigned long timeoutMs = 10000, uint32_t rtcSlot = 96);
+  void saveResumeState();
+  // The results below are returned as copies. On ESP32 the async worker
+  // writes them too: while it is sending, these wait for the send to end,
+  // and they then describe the latest send of either task. Read async
+  // results with sendStatus()/sendError() or the completion callback.
+  WaavisWakeReport wakeReport() const;
   String lastError() const;
+  WaavisResponse lastResponse() const;
+  WaavisTiming lastTiming() const;
+  WaavisEndpointStats stats(WaavisEndpoint endpoint) const;
+  void resetStats();
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  WaavisMemoryProfile lastMemoryProfile() const;
+#endif
 
 private:
   String _baseUrl;
@@ -31,20 +365,211 @@ private:
   const char* _sslCert;
   String _lastError;
 
-  bool sendPost(const String &path, const String &token, const String &body);
+  String _host;
+  String _basePath;
+  uint16_t _port;
+  bool _https;
+  bool _keepAlive;
+  unsigned long _idleTimeout;
+  unsigned long _lastActivity;
+  // The last readResponse() saw the server close before any response byte.
+  bool _closedUnanswered;
+  // The last sendRequest() got its request head out, so the server may have
+  // acted on the request even though the call failed.
+  bool _requestStarted;
+  unsigned long _deadline;
+  unsigned long _deadlineStart;
+  // timingBegin() leaves _deadlineStart alone, so a relay's download and
+  // upload share one deadline.
+  bool _holdDeadline;
+  uint32_t _tlsSessionHits;
+  uint32_t _tlsSessionMisses;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  BearSSL::WiFiClientSecure _secureClient;
+  BearSSL::Session _tlsSession;
+  BearSSL::X509List *_trustAnchors;
+  BearSSL::PublicKey *_pinnedKey;
+  uint16_t _tlsFragmentLength;
+  int8_t _tlsFragmentSupported;  // -1 until probed
+  // Last relay source probed for Maximum Fragment Length, and its answer.
+  String _relayProbeHost;
+  uint16_t _relayProbePort;
+  bool _relayFragmentSupported;
+#elif WAAVIS_ENABLE_TLS
+  WiFiClientSecure _secureClient;
+#endif
+#if WAAVIS_ENABLE_TLS
+  uint8_t _fingerprint[32];
+  uint8_t _fingerprintLen;
+#endif
+  bool _tlsDirty;
+  WiFiClient _plainClient;
+  Client *_transport;
+  bool _transportNonBlocking;
+  WaavisResponse _lastResponse;
+  WaavisTiming _lastTiming;
+  uint32_t _timingStart;
+  WaavisEndpointStats _stats[WAAVIS_ENDPOINT_COUNT];
+  WaavisWakeReport _wakeReport;
+  uint32_t _resumeSlot;
+  uint32_t _serverIp;
+  uint32_t _resumeServerIp;
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  WaavisMemoryProfile _memoryProfile;
+  int32_t _blocksBefore;
+  void sampleMemory();
+#endif
+  uint8_t _pipelineDepth;
+#if WAAVIS_ENABLE_MEDIA
+  unsigned long _streamIdleTimeout;
+  WaavisProgressCallback _progressCallback;
+  void *_progressArg;
+  size_t _uploadSent;
+  size_t _uploadTotal;
+  unsigned long _uploadStart;
+  bool _uploadCancelled;
+  uint32_t _uplinkBandwidth;
+#endif
+
+  enum class StepState : uint8_t { Idle, Connect, Head, Body, Response };
+  // The send being advanced by poll().
+  struct StepSend {
+    StepState state;
+    WaavisEndpoint endpoint;
+    String path;
+    String token;
+    String contentType;
+    String head;
+    String tail;
+    String request;  // HTTP head still to write (non-blocking transport)
+    const uint8_t *data;
+    Stream *file;
+    size_t dataSize;
+    uint8_t piece;
+    size_t offset;
+    Client *client;
+    bool reused;
+    bool locked;
+    unsigned long since;
+  };
+  StepSend _step;
+
+#if WAAVIS_ENABLE_OUTBOX
+  fs::FS *_outboxFs;
+  String _outboxPath;
+  uint8_t *_outboxStage;
+  size_t _outboxStageLen;
+  unsigned long _outboxStagedAt;
+  uint32_t _outboxNextId;
+  uint32_t _outboxDeliveredId;
+  size_t _outboxPending;
+  size_t _outboxAcked;
+  uint32_t _outboxReadPos;
+  unsigned long _outboxNextAttempt;
+  unsigned long _outboxBackoff;
+#endif
+
+#if defined(ESP32)
+  class IoLock {
+  public:
+    explicit IoLock(SemaphoreHandle_t lock) : _lock(lock) {
+      if (_lock != nullptr) {
+        xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+      }
+    }
+    ~IoLock() {
+      if (_lock != nullptr) {
+        xSemaphoreGiveRecursive(_lock);
+      }
+    }
+
+  private:
+    SemaphoreHandle_t _lock;
+  };
+
+  struct AsyncJob;
+  AsyncJob *_asyncJobs;
+  uint8_t _asyncJobCount;
+  uint32_t _nextTicket;
+  QueueHandle_t _asyncHigh;
+  QueueHandle_t _asyncNormal;
+  SemaphoreHandle_t _asyncPending;
+  SemaphoreHandle_t _asyncLock;
+  SemaphoreHandle_t _ioLock;
+  SemaphoreHandle_t _asyncExited;  // given by the worker as it leaves
+  volatile bool _asyncStop;
+  TaskHandle_t _asyncTask;
+  WaavisSendCallback _asyncCallback;
+  void *_asyncCallbackArg;
+
+  void releaseAsync();
+  AsyncJob *reserveJob();
+  uint32_t submitJob(AsyncJob *job, WaavisPriority priority);
+  bool runJob(AsyncJob &job);
+  void asyncLoop();
+  static void asyncTask(void *arg);
+#endif
+
+  void timingBegin();
+  void markPhase(WaavisPhase phase);
+  void timingEnd(WaavisEndpoint endpoint, bool ok);
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  void applyTlsBufferSizes();
+#endif
+#if WAAVIS_ENABLE_TLS
+  bool applyTlsTrust();
+#endif
+  bool linkUp() const;
+  bool stepBusy();
+  unsigned long waitBudget(unsigned long capMs) const;
+  bool timedOut();
+  Client *openConnection(bool &reused);
+  String requestHead(const char *method, const String &path, const String &token,
+                     const String &contentType, long contentLength) const;
+  bool writeRequestHead(Client &client, const char *method, const String &path,
+                        const String &token, const String &contentType,
+                        long contentLength);
+  bool readBody(Client &client, size_t length, WaavisJsonScanner &scanner);
+  bool readResponse(Client &client);
+  bool finishResponse();
+  bool sendRequest(const char *method, const String &path, const String &token,
+                   const String &contentType, const String &head,
+                   const uint8_t *data = nullptr, size_t dataSize = 0,
+                   const String &tail = String(),
+                   const WaavisForm *form = nullptr);
+  bool sendOrQueue(const char *method, const String &path, const String &token,
+                   const WaavisForm *form);
+  void beginUpload(size_t total);
+  bool reportUpload(size_t bytes);
+  void endUpload();
+  bool uploadCancelled() const;
+  bool writeUpload(Client &client, const uint8_t *data, size_t len);
+  bool beginStep(WaavisEndpoint endpoint, const char *path, const String &token,
+                 const String &contentType, const String &head,
+                 const uint8_t *data, Stream *file, size_t dataSize,
+                 const String &tail);
+  WaavisPollResult stepOnce(bool &waiting);
+  bool stepWriteBody(size_t room);
+  WaavisPollResult stepWaitWritable(bool &waiting);
+  WaavisPollResult stepFail(bool closed);
+  WaavisPollResult stepFinish(bool ok);
+#if WAAVIS_ENABLE_OUTBOX
+  bool queueOutbox(const char *method, const String &path, const String &token,
+                   const String &body);
+  bool stageOutbox(uint8_t type, const uint8_t *payload, size_t len);
+  bool compactOutbox();
+#endif
+#if WAAVIS_ENABLE_MEDIA
   bool sendChatMediaStream(const String &token, const String &to,
                            const String &message, bool typing,
                            const String &type, Stream &file,
                            size_t fileSize, const String &fileName);
-  bool sendChatMediaBuffer(const String &token, const String &to,
-                           const String &message, bool typing,
-                           const String &type, const uint8_t *data,
-                           size_t dataSize, const String &fileName);
   bool sendChatMediaStreamChunked(const String &token, const String &to,
                                   const String &message, bool typing,
                                   const String &type, Stream &file,
-                                  const String &fileName);
-  String urlEncode(const String &value) const;
+                                  size_t fileSize, const String &fileName,
+                                  const volatile bool *sourceDone = nullptr);
+#endif
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,433 @@
+#include "WaavisInternal.h"
+
+#if defined(ESP32)
+
+struct WaavisClient::AsyncJob {
+  enum Kind : uint8_t {
+    Chat,
+    ChatPost,
+    ChatLink,
+    ChatMedia,
+    ChatMediaBuffer,
+    ChatMediaFromUrl
+  };
+
+  uint32_t ticket;
+  WaavisSendStatus status;
+  Kind kind;
+  bool typing;
+  String token;
+  String to;
+  String message;
+  String link;
+  String linkTitle;
+  String linkDescription;
+  String type;
+  String fileName;
+  Stream *file;
+  const uint8_t *data;
+  size_t fileSize;
+  String error;
+};
+
+WaavisClient::~WaavisClient() {
+#if WAAVIS_ENABLE_OUTBOX
+  free(_outboxStage);
+#endif
+  if (_asyncTask != nullptr) {
+    // Deleting the worker mid-send would leave _ioLock taken and its queues
+    // in use; let it finish the current job and leave on its own.
+    _asyncStop = true;
+    xSemaphoreGive(_asyncPending);
+    xSemaphoreTake(_asyncExited, portMAX_DELAY);
+  }
+  releaseAsync();
+}
+
+// Frees whatever beginAsync() created; the worker must not be running.
+void WaavisClient::releaseAsync() {
+  if (_asyncHigh != nullptr) {
+    vQueueDelete(_asyncHigh);
+  }
+  if (_asyncNormal != nullptr) {
+    vQueueDelete(_asyncNormal);
+  }
+  if (_asyncPending != nullptr) {
+    vSemaphoreDelete(_asyncPending);
+  }
+  if (_asyncLock != nullptr) {
+    vSemaphoreDelete(_asyncLock);
+  }
+  if (_ioLock != nullptr) {
+    vSemaphoreDelete(_ioLock);
+  }
+  if (_asyncExited != nullptr) {
+    vSemaphoreDelete(_asyncExited);
+  }
+  delete[] _asyncJobs;
+  _asyncHigh = nullptr;
+  _asyncNormal = nullptr;
+  _asyncPending = nullptr;
+  _asyncLock = nullptr;
+  _ioLock = nullptr;
+  _asyncExited = nullptr;
+  _asyncJobs = nullptr;
+  _asyncJobCount = 0;
+  _asyncTask = nullptr;
+}
+
+bool WaavisClient::beginAsync(uint8_t queueLength, uint32_t stackSize,
+                              UBaseType_t taskPriority) {
+  if (_asyncTask != nullptr) {
+    return true;
+  }
+  if (queueLength == 0) {
+    _lastError = "Invalid queue length";
+    return false;
+  }
+
+  _asyncJobs = new AsyncJob[queueLength];
+  _asyncJobCount = queueLength;
+  for (uint8_t i = 0; i < queueLength; ++i) {
+    _asyncJobs[i].ticket = 0;
+    _asyncJobs[i].status = WaavisSendStatus::Unknown;
+  }
+  _asyncHigh = xQueueCreate(queueLength, sizeof(uint8_t));
+  _asyncNormal = xQueueCreate(queueLength, sizeof(uint8_t));
+  _asyncPending = xSemaphoreCreateCounting(queueLength, 0);
+  _asyncLock = xSemaphoreCreateMutex();
+  _ioLock = xSemaphoreCreateRecursiveMutex();
+  _asyncExited = xSemaphoreCreateBinary();
+  _asyncStop = false;
+
+#if portNUM_PROCESSORS > 1
+  BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+#else
+  BaseType_t core = 0;
+#endif
+  if (_asyncHigh == nullptr || _asyncNormal == nullptr ||
+      _asyncPending == nullptr || _asyncLock == nullptr || _ioLock == nullptr ||
+      _asyncExited == nullptr ||
+      xTaskCreatePinnedToCore(asyncTask, "waavis", stackSize, this, taskPriority,
+                              &_asyncTask, core) != pdPASS) {
+    // Leave nothing half-built, so a later call can start over.
+    releaseAsync();
+    _lastError = "Async worker start failed";
+    return false;
+  }
+  return true;
+}
+
+void WaavisClient::onSendComplete(WaavisSendCallback callback, void *arg) {
+  _asyncCallback = callback;
+  _asyncCallbackArg = arg;
+}
+
+// Picks a free slot, or the slot holding the oldest finished result. Called
+// with _asyncLock held.
+WaavisClient::AsyncJob *WaavisClient::reserveJob() {
+  AsyncJob *best = nullptr;
+  for (uint8_t i = 0; i < _asyncJobCount; ++i) {
+    AsyncJob &job = _asyncJobs[i];
+    if (job.status == WaavisSendStatus::Unknown) {
+      best = &job;
+      break;
+    }
+    if ((job.status == WaavisSendStatus::Done ||
+         job.status == WaavisSendStatus::Failed) &&
+        (best == nullptr || job.ticket - best->ticket > 0x80000000UL)) {
+      best = &job;
+    }
+  }
+  if (best == nullptr) {
+    return nullptr;
+  }
+  best->ticket = _nextTicket++;
+  if (_nextTicket == 0) {
+    _nextTicket = 1;
+  }
+  best->status = WaavisSendStatus::Queued;
+  best->typing = false;
+  best->file = nullptr;
+  best->data = nullptr;
+  best->fileSize = 0;
+  best->error = String();
+  return best;
+}
+
+uint32_t WaavisClient::submitJob(AsyncJob *job, WaavisPriority priority) {
+  uint8_t slot = static_cast<uint8_t>(job - _asyncJobs);
+  uint32_t ticket = job->ticket;
+  QueueHandle_t queue = priority == WaavisPriority::High ? _asyncHigh : _asyncNormal;
+  xSemaphoreGive(_asyncLock);
+  xQueueSend(queue, &slot, 0);
+  xSemaphoreGive(_asyncPending);
+  return ticket;
+}
+
+uint32_t WaavisClient::sendChatAsync(const String &token, const String &to,
+                                     const String &message,
+                                     WaavisPriority priority) {
+  if (_asyncTask == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  AsyncJob *job = reserveJob();
+  if (job == nullptr) {
+    xSemaphoreGive(_asyncLock);
+    return 0;
+  }
+  job->kind = AsyncJob::Chat;
+  job->token = token;
+  job->to = to;
+  job->message = message;
+  return submitJob(job, priority);
+}
+
+uint32_t WaavisClient::sendChatPostAsync(const String &token, const String &to,
+                                         const String &message, bool typing,
+                                         WaavisPriority priority) {
+  if (_asyncTask == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  AsyncJob *job = reserveJob();
+  if (job == nullptr) {
+    xSemaphoreGive(_asyncLock);
+    return 0;
+  }
+  job->kind = AsyncJob::ChatPost;
+  job->token = token;
+  job->to = to;
+  job->message = message;
+  job->typing = typing;
+  return submitJob(job, priority);
+}
+
+#if WAAVIS_ENABLE_LINK
+uint32_t WaavisClient::sendChatLinkAsync(const String &token, const String &to,
+                                         const String &message, bool typing,
+                                         const String &link,
+                                         const String &linkTitle,
+                                         const String &linkDescription,
+                                         WaavisPriority priority) {
+  if (_asyncTask == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  AsyncJob *job = reserveJob();
+  if (job == nullptr) {
+    xSemaphoreGive(_asyncLock);
+    return 0;
+  }
+  job->kind = AsyncJob::ChatLink;
+  job->token = token;
+  job->to = to;
+  job->message = message;
+  job->typing = typing;
+  job->link = link;
+  job->linkTitle = linkTitle;
+  job->linkDescription = linkDescription;
+  return submitJob(job, priority);
+}
+#endif
+
+#if WAAVIS_ENABLE_MEDIA
+uint32_t WaavisClient::sendChatMediaAsync(const String &token, const String &to,
+                                          const String &message, bool typing,
+                                          const String &type, Stream &file,
+                                          size_t fileSize,
+                                          const String &fileName,
+                                          WaavisPriority priority) {
+  if (_asyncTask == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  AsyncJob *job = reserveJob();
+  if (job == nullptr) {
+    xSemaphoreGive(_asyncLock);
+    return 0;
+  }
+  job->kind = AsyncJob::ChatMedia;
+  job->token = token;
+  job->to = to;
+  job->message = message;
+  job->typing = typing;
+  job->type = type;
+  job->file = &file;
+  job->fileSize = fileSize;
+  job->fileName = fileName;
+  return submitJob(job, priority);
+}
+
+uint32_t WaavisClient::sendChatMediaBufferAsync(const String &token,
+                                                const String &to,
+                                                const String &message,
+                                                bool typing, const String &type,
+                                                const uint8_t *data,
+                                                size_t dataSize,
+                                                const String &fileName,
+                                                WaavisPriority priority) {
+  if (_asyncTask == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  AsyncJob *job = reserveJob();
+  if (job == nullptr) {
+    xSemaphoreGive(_asyncLock);
+    return 0;
+  }
+  job->kind = AsyncJob::ChatMediaBuffer;
+  job->token = token;
+  job->to = to;
+  job->message = message;
+  job->typing = typing;
+  job->type = type;
+  job->data = data;
+  job->fileSize = dataSize;
+  job->fileName = fileName;
+  return submitJob(job, priority);
+}
+
+uint32_t WaavisClient::sendChatMediaFromUrlAsync(const String &token,
+                                                 const String &to,
+                                                 const String &caption,
+                                                 bool typing,
+                                                 const String &imageUrl,
+                                                 WaavisPriority priority) {
+  if (_asyncTask == nullptr) {
+    return 0;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  AsyncJob *job = reserveJob();
+  if (job == nullptr) {
+    xSemaphoreGive(_asyncLock);
+    return 0;
+  }
+  job->kind = AsyncJob::ChatMediaFromUrl;
+  job->token = token;
+  job->to = to;
+  job->message = caption;
+  job->typing = typing;
+  job->link = imageUrl;
+  return submitJob(job, priority);
+}
+#endif
+
+WaavisSendStatus WaavisClient::sendStatus(uint32_t ticket) {
+  WaavisSendStatus status = WaavisSendStatus::Unknown;
+  if (_asyncTask == nullptr || ticket == 0) {
+    return status;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  for (uint8_t i = 0; i < _asyncJobCount; ++i) {
+    if (_asyncJobs[i].ticket == ticket) {
+      status = _asyncJobs[i].status;
+      break;
+    }
+  }
+  xSemaphoreGive(_asyncLock);
+  return status;
+}
+
+String WaavisClient::sendError(uint32_t ticket) {
+  String error;
+  if (_asyncTask == nullptr || ticket == 0) {
+    return error;
+  }
+  xSemaphoreTake(_asyncLock, portMAX_DELAY);
+  for (uint8_t i = 0; i < _asyncJobCount; ++i) {
+    if (_asyncJobs[i].ticket == ticket) {
+      error = _asyncJobs[i].error;
+      break;
+    }
+  }
+  xSemaphoreGive(_asyncLock);
+  return error;
+}
+
+bool WaavisClient::runJob(AsyncJob &job) {
+  switch (job.kind) {
+    case AsyncJob::Chat:
+      return sendChat(job.token, job.to, job.message);
+    case AsyncJob::ChatPost:
+      return sendChatPost(job.token, job.to, job.message, job.typing);
+#if WAAVIS_ENABLE_LINK
+    case AsyncJob::ChatLink:
+      return sendChatLink(job.token, job.to, job.message, job.typing, job.link,
+                          job.linkTitle, job.linkDescription);
+#endif
+#if WAAVIS_ENABLE_MEDIA
+    case AsyncJob::ChatMedia:
+      return sendChatMedia(job.token, job.to, job.message, job.typing, job.type,
+                           *job.file, job.fileSize, job.fileName);
+    case AsyncJob::ChatMediaBuffer:
+      return sendChatMediaBuffer(job.token, job.to, job.message, job.typing,
+                                 job.type, job.data, job.fileSize, job.fileName);
+    case AsyncJob::ChatMediaFromUrl:
+      return sendChatMediaFromUrl(job.token, job.to, job.message, job.typing,
+                                  job.link);
+#endif
+    default:
+      break;
+  }
+  return false;
+}
+
+void WaavisClient::asyncLoop() {
+  while (true) {
+    xSemaphoreTake(_asyncPending, portMAX_DELAY);
+    if (_asyncStop) {
+      return;
+    }
+    uint8_t slot = 0;
+    if (xQueueReceive(_asyncHigh, &slot, 0) != pdTRUE &&
+        xQueueReceive(_asyncNormal, &slot, 0) != pdTRUE) {
+      continue;
+    }
+
+    AsyncJob &job = _asyncJobs[slot];
+    xSemaphoreTake(_asyncLock, portMAX_DELAY);
+    job.status = WaavisSendStatus::Running;
+    xSemaphoreGive(_asyncLock);
+
+    bool ok;
+    String error;
+    {
+      IoLock lock(_ioLock);
+      ok = runJob(job);
+      error = _lastError;
+    }
+
+    xSemaphoreTake(_asyncLock, portMAX_DELAY);
+    uint32_t ticket = job.ticket;
+    job.status = ok ? WaavisSendStatus::Done : WaavisSendStatus::Failed;
+    job.error = error;
+    // Release the payload now; only the result is kept for sendStatus().
+    job.token = String();
+    job.to = String();
+    job.message = String();
+    job.link = String();
+    job.linkTitle = String();
+    job.linkDescription = String();
+    job.type = String();
+    job.fileName = String();
+    job.file = nullptr;
+    job.data = nullptr;
+    xSemaphoreGive(_asyncLock);
+
+    if (_asyncCallback != nullptr) {
+      _asyncCallback(ticket, ok, error, _asyncCallbackArg);
+    }
+  }
+}
+
+void WaavisClient::asyncTask(void *arg) {
+  WaavisClient *client = static_cast<WaavisClient *>(arg);
+  client->asyncLoop();
+  // The destructor frees the client once this is given; touch nothing after.
+  xSemaphoreGive(client->_asyncExited);
+  vTaskDelete(nullptr);
+}
+
+#endif
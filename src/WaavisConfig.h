@@ -0,0 +1,59 @@
+#ifndef WAAVIS_CONFIG_H
+#define WAAVIS_CONFIG_H
+
+// Compile-time feature switches. Arduino builds the library separately from
+// the sketch, so a #define in the .ino does not reach it: set these as build
+// flags (e.g. build_flags = -DWAAVIS_ENABLE_MEDIA=0 in PlatformIO). A
+// disabled feature's methods are not declared, so a sketch that still calls
+// one fails to compile instead of linking dead code.
+
+// HTTPS via BearSSL (ESP8266) / mbedTLS (ESP32). Without it only http://
+// base URLs work and no TLS client is linked or constructed.
+#ifndef WAAVIS_ENABLE_TLS
+#define WAAVIS_ENABLE_TLS 1
+#endif
+
+// sendChatLink / sendChatLinkAsync.
+#ifndef WAAVIS_ENABLE_LINK
+#define WAAVIS_ENABLE_LINK 1
+#endif
+
+// sendChatMedia, sendChatMediaFromUrl and their async variants, including
+// the multipart and chunked upload paths.
+#ifndef WAAVIS_ENABLE_MEDIA
+#define WAAVIS_ENABLE_MEDIA 1
+#endif
+
+// beginOutbox / processOutbox and the on-flash journal.
+#ifndef WAAVIS_ENABLE_OUTBOX
+#define WAAVIS_ENABLE_OUTBOX 1
+#endif
+
+// Per-call heap profiling (lastMemoryProfile()). Off by default: every
+// phase boundary then also samples the heap.
+#ifndef WAAVIS_ENABLE_MEMORY_PROFILE
+#define WAAVIS_ENABLE_MEMORY_PROFILE 0
+#endif
+
+// Events recorded into the trace ring (see WaavisTrace.h): 0 none, 1 errors,
+// 2 also connection and upload milestones, 3 everything. Builds that set
+// WAAVIS_DEBUG=0 keep getting no tracing.
+#ifndef WAAVIS_TRACE_LEVEL
+#if defined(WAAVIS_DEBUG) && !WAAVIS_DEBUG
+#define WAAVIS_TRACE_LEVEL 0
+#else
+#define WAAVIS_TRACE_LEVEL 2
+#endif
+#endif
+
+// Trace ring capacity in events (12 bytes each).
+#ifndef WAAVIS_TRACE_SIZE
+#define WAAVIS_TRACE_SIZE 64
+#endif
+
+// ESP32 listSPIFFSFiles() debugging helper.
+#ifndef WAAVIS_ENABLE_SPIFFS_LIST
+#define WAAVIS_ENABLE_SPIFFS_LIST 1
+#endif
+
+#endif
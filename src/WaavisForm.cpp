@@ -0,0 +1,178 @@
+#include "WaavisForm.h"
+#include "WaavisInternal.h"
+
+WaavisForm::WaavisForm() : _count(0) {}
+
+void WaavisForm::add(const char *name, const String &value) {
+  if (_count < kMaxFields) {
+    _fields[_count++] = {name, value.c_str(), value.length(), false, nullptr, nullptr, 0};
+  }
+}
+
+void WaavisForm::addEncoded(const char *name, const String &value) {
+  if (_count < kMaxFields) {
+    _fields[_count++] = {name, value.c_str(), value.length(), true, nullptr, nullptr, 0};
+  }
+}
+
+void WaavisForm::add(const char *name, const char *value) {
+  if (_count < kMaxFields) {
+    _fields[_count++] = {name, value, strlen(value), false, nullptr, nullptr, 0};
+  }
+}
+
+void WaavisForm::add(const char *name, const WaavisTemplate &tpl,
+                     const WaavisValue *values, size_t count) {
+  if (_count < kMaxFields) {
+    _fields[_count++] = {name, nullptr, 0, false, &tpl, values, count};
+  }
+}
+
+static size_t encodedLength(const char *value, size_t len) {
+  size_t total = 0;
+  for (size_t i = 0; i < len; ++i) {
+    total += waavisIsUnreserved(value[i]) ? 1 : 3;
+  }
+  return total;
+}
+
+size_t WaavisForm::length() const {
+  size_t total = 0;
+  for (uint8_t f = 0; f < _count; ++f) {
+    const Field &field = _fields[f];
+    total += (f > 0 ? 1 : 0) + strlen(field.name) + 1;
+    if (field.tpl == nullptr) {
+      total += field.encoded ? field.valueLen : encodedLength(field.value, field.valueLen);
+      continue;
+    }
+    char number[WaavisValue::kMaxNumberLength];
+    for (uint8_t i = 0; i <= field.tpl->fieldCount(); ++i) {
+      size_t len;
+      field.tpl->segment(i, len);
+      total += len;
+      if (i < field.tpl->fieldCount() && i < field.valueCount) {
+        const WaavisValue &value = field.values[i];
+        total += value.isText() ? encodedLength(value.text(), strlen(value.text()))
+                                : value.formatNumber(number);
+      }
+    }
+  }
+  return total;
+}
+
+// Feeds the encoded form to sink(data, len) in pieces of up to 128 bytes.
+template <typename Sink>
+bool WaavisForm::encode(Sink sink) const {
+  static const char hex[] = "0123456789ABCDEF";
+  char buffer[128];
+  size_t used = 0;
+  auto put = [&](char c) {
+    if (used == sizeof(buffer)) {
+      if (!sink(buffer, used)) {
+        return false;
+      }
+      used = 0;
+    }
+    buffer[used++] = c;
+    return true;
+  };
+  auto putEncoded = [&](const char *value, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+      char c = value[i];
+      bool ok = waavisIsUnreserved(c) ? put(c)
+                                      : put('%') && put(hex[(c >> 4) & 0x0F]) &&
+                                            put(hex[c & 0x0F]);
+      if (!ok) {
+        return false;
+      }
+    }
+    return true;
+  };
+  // Already-encoded text is copied through as-is.
+  auto putRaw = [&](const char *data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+      if (!put(data[i])) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  for (uint8_t f = 0; f < _count; ++f) {
+    if (f > 0 && !put('&')) {
+      return false;
+    }
+    for (const char *p = _fields[f].name; *p != '\0'; ++p) {
+      if (!put(*p)) {
+        return false;
+      }
+    }
+    if (!put('=')) {
+      return false;
+    }
+    const Field &field = _fields[f];
+    if (field.tpl == nullptr) {
+      bool ok = field.encoded ? putRaw(field.value, field.valueLen)
+                              : putEncoded(field.value, field.valueLen);
+      if (!ok) {
+        return false;
+      }
+      continue;
+    }
+    char number[WaavisValue::kMaxNumberLength];
+    for (uint8_t i = 0; i <= field.tpl->fieldCount(); ++i) {
+      size_t len;
+      const char *segment = field.tpl->segment(i, len);
+      if (!putRaw(segment, len)) {
+        return false;
+      }
+      if (i < field.tpl->fieldCount() && i < field.valueCount) {
+        const WaavisValue &value = field.values[i];
+        bool ok = value.isText() ? putEncoded(value.text(), strlen(value.text()))
+                                 : putRaw(number, value.formatNumber(number));
+        if (!ok) {
+          return false;
+        }
+      }
+    }
+  }
+  return used == 0 || sink(buffer, used);
+}
+
+bool WaavisForm::writeTo(Client &client) const {
+  return encode([&client](const char *data, size_t len) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+    while (len > 0) {
+      size_t written = client.write(bytes, len);
+      if (written == 0) {
+        return false;
+      }
+      bytes += written;
+      len -= written;
+    }
+    return true;
+  });
+}
+
+void WaavisForm::encodeValue(const String &value, String &out) {
+  static const char hex[] = "0123456789ABCDEF";
+  out.reserve(out.length() + encodedLength(value.c_str(), value.length()));
+  for (size_t i = 0; i < value.length(); ++i) {
+    char c = value[i];
+    if (waavisIsUnreserved(c)) {
+      out += c;
+    } else {
+      out += '%';
+      out += hex[(c >> 4) & 0x0F];
+      out += hex[c & 0x0F];
+    }
+  }
+}
+
+void WaavisForm::appendTo(String &out) const {
+  out.reserve(out.length() + length());
+  encode([&out](const char *data, size_t len) {
+    out.concat(data, len);
+    return true;
+  });
+}
@@ -0,0 +1,48 @@
+#ifndef WAAVIS_FORM_H
+#define WAAVIS_FORM_H
+
+#include "Waavis.h"
+
+// application/x-www-form-urlencoded body built from borrowed field values.
+// length() gives the exact encoded size up front so the body can be sent
+// with Content-Length and encoded straight into the connection through a
+// small stack buffer, without materializing it on the heap.
+class WaavisForm {
+public:
+  static const uint8_t kMaxFields = 6;
+
+  WaavisForm();
+  // name and value must outlive the form.
+  void add(const char *name, const String &value);
+  void add(const char *name, const char *value);
+  // value is already URL-encoded (see encodeValue) and is copied as-is.
+  void addEncoded(const char *name, const String &value);
+  // Renders tpl with values as the field value; all must outlive the form.
+  void add(const char *name, const WaavisTemplate &tpl,
+           const WaavisValue *values, size_t count);
+  size_t length() const;
+  bool writeTo(Client &client) const;
+  // Appends the encoded form to out with a single reservation.
+  void appendTo(String &out) const;
+  // URL-encodes value into out, for a field sent in many forms.
+  static void encodeValue(const String &value, String &out);
+
+private:
+  struct Field {
+    const char *name;
+    const char *value;
+    size_t valueLen;
+    bool encoded;
+    const WaavisTemplate *tpl;
+    const WaavisValue *values;
+    size_t valueCount;
+  };
+
+  Field _fields[kMaxFields];
+  uint8_t _count;
+
+  template <typename Sink>
+  bool encode(Sink sink) const;
+};
+
+#endif
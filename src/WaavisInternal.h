@@ -0,0 +1,69 @@
+#ifndef WAAVIS_INTERNAL_H
+#define WAAVIS_INTERNAL_H
+
+#include "Waavis.h"
+
+#define WAAVIS_TRACE_ERROR 1
+#define WAAVIS_TRACE_INFO 2
+#define WAAVIS_TRACE_VERBOSE 3
+
+// Events above WAAVIS_TRACE_LEVEL compile to nothing.
+#define WAAVIS_TRACE(level, event, arg)                                  \
+  do {                                                                   \
+    if (WAAVIS_TRACE_##level <= WAAVIS_TRACE_LEVEL) {                    \
+      waavisTrace(WAAVIS_TRACE_##level, WaavisEvent::event,              \
+                  static_cast<int32_t>(arg));                            \
+    }                                                                    \
+  } while (0)
+
+#if defined(ESP32)
+// Serializes sends between the caller and the async worker task.
+#define WAAVIS_IO_LOCK() IoLock ioLock(_ioLock)
+#else
+#define WAAVIS_IO_LOCK() do {} while (0)
+#endif
+
+static const unsigned long kConnectTimeoutMs = 5000;
+static const unsigned long kResponseTimeoutMs = 5000;
+static const char kFormContentType[] = "application/x-www-form-urlencoded";
+#if defined(ESP8266)
+// The loop task has a 4 KB stack.
+static const size_t kUploadBufferSize = 512;
+#else
+static const size_t kUploadBufferSize = 1024;
+#endif
+
+// Shared by the blocking, relay and step-based send paths (Waavis.cpp).
+String waavisParseHost(const String &url, bool &isHttps, uint16_t &port,
+                       String &path);
+bool waavisWaitForData(Client &client, unsigned long timeoutMs);
+int waavisReadLine(Client &client, char *line, size_t size,
+                   unsigned long timeoutMs);
+bool waavisHeaderIs(const char *line, const char *name, const char **value);
+bool waavisWriteAll(Client &client, const uint8_t *data, size_t len);
+bool waavisWriteAll(Client &client, const String &data);
+#if WAAVIS_ENABLE_MEDIA
+String waavisMediaToPart(const String &boundary, const String &to);
+String waavisMediaCommonParts(const String &boundary, const String &message,
+                              bool typing, const String &type,
+                              const String &fileName);
+#endif
+
+// RFC 3986 unreserved characters, sent as-is in form bodies.
+static inline bool waavisIsUnreserved(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.' || c == '~';
+}
+
+// CRC-32 (IEEE); start with 0xFFFFFFFF and invert the result.
+static inline uint32_t waavisCrc32(uint32_t crc, const uint8_t *data, size_t len) {
+  while (len-- > 0) {
+    crc ^= *data++;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1)));
+    }
+  }
+  return crc;
+}
+
+#endif
@@ -0,0 +1,236 @@
+#include "WaavisJson.h"
+
+static const uint8_t kMaxDepth = 32;
+
+WaavisJsonScanner::WaavisJsonScanner(WaavisResponse &result)
+    : _result(result), _state(Value), _target(None), _containers(0), _depth(0),
+      _errorDepth(0), _expectKey(false), _errorFromMessage(false),
+      _out(nullptr), _outCap(0), _outLen(0), _unicode(0), _unicodeDigits(0) {
+  _key[0] = '\0';
+}
+
+bool WaavisJsonScanner::inObject() const {
+  return _depth > 0 && (_containers & (1UL << (_depth - 1))) != 0;
+}
+
+// Decides where the value that starts now should be captured.
+void WaavisJsonScanner::beginValue(bool isString) {
+  _out = nullptr;
+  _outCap = 0;
+  _outLen = 0;
+  _target = None;
+
+  if (isString && _expectKey) {
+    _target = Key;
+    _out = _key;
+    _outCap = sizeof(_key);
+    return;
+  }
+  if (!inObject()) {
+    return;
+  }
+
+  bool inError = _errorDepth != 0 && _depth == _errorDepth;
+  if (strcmp(_key, "error") == 0 && isString && _depth == 1) {
+    if (_result.error[0] == '\0' || _errorFromMessage) {
+      _target = Error;
+      _errorFromMessage = false;
+    }
+  } else if (strcmp(_key, "message") == 0 && isString) {
+    if (inError && (_result.error[0] == '\0' || _errorFromMessage)) {
+      _target = Error;
+      _errorFromMessage = false;
+    } else if (_depth == 1 && _result.error[0] == '\0') {
+      // Used as error text only until a real "error" field shows up.
+      _target = TopMessage;
+    }
+  } else if (strcmp(_key, "code") == 0 || strcmp(_key, "error_code") == 0) {
+    if (_result.errorCode[0] == '\0') {
+      _target = ErrorCode;
+    }
+  } else if (strcmp(_key, "id") == 0 || strcmp(_key, "message_id") == 0) {
+    if (_result.messageId[0] == '\0') {
+      _target = MessageId;
+    }
+  }
+
+  switch (_target) {
+    case MessageId:
+      _out = _result.messageId;
+      _outCap = sizeof(_result.messageId);
+      break;
+    case ErrorCode:
+      _out = _result.errorCode;
+      _outCap = sizeof(_result.errorCode);
+      break;
+    case Error:
+    case TopMessage:
+      _out = _result.error;
+      _outCap = sizeof(_result.error);
+      break;
+    default:
+      break;
+  }
+}
+
+void WaavisJsonScanner::put(char c) {
+  if (_out != nullptr && _outLen + 1 < _outCap) {
+    _out[_outLen++] = c;
+  }
+}
+
+void WaavisJsonScanner::endValue() {
+  if (_out != nullptr) {
+    _out[_outLen] = '\0';
+  }
+  if (_target == Key) {
+    _expectKey = false;
+  } else if (_target == TopMessage) {
+    _errorFromMessage = true;
+  }
+  _out = nullptr;
+  _target = None;
+}
+
+void WaavisJsonScanner::literalChar(char c) {
+  if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\r' ||
+      c == '\n') {
+    endValue();
+    _state = Value;
+    return;
+  }
+  put(c);
+}
+
+void WaavisJsonScanner::feed(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len && _state != Stopped; ++i) {
+    char c = static_cast<char>(data[i]);
+
+    if (_state == Literal) {
+      literalChar(c);
+      if (_state == Literal) {
+        continue;
+      }
+    }
+
+    switch (_state) {
+      case InString:
+        if (c == '"') {
+          endValue();
+          _state = Value;
+        } else if (c == '\\') {
+          _state = Escape;
+        } else {
+          put(c);
+        }
+        break;
+
+      case Escape:
+        _state = InString;
+        switch (c) {
+          case 'n': put('\n'); break;
+          case 't': put('\t'); break;
+          case 'r': put('\r'); break;
+          case 'b': put('\b'); break;
+          case 'f': put('\f'); break;
+          case 'u':
+            _unicode = 0;
+            _unicodeDigits = 0;
+            _state = Unicode;
+            break;
+          default: put(c); break;
+        }
+        break;
+
+      case Unicode: {
+        uint8_t digit;
+        if (c >= '0' && c <= '9') {
+          digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+          digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+          digit = c - 'A' + 10;
+        } else {
+          _state = Stopped;
+          break;
+        }
+        _unicode = static_cast<uint16_t>((_unicode << 4) | digit);
+        if (++_unicodeDigits < 4) {
+          break;
+        }
+        // Encode as UTF-8; surrogate halves are replaced.
+        if (_unicode < 0x80) {
+          put(static_cast<char>(_unicode));
+        } else if (_unicode < 0x800) {
+          put(static_cast<char>(0xC0 | (_unicode >> 6)));
+          put(static_cast<char>(0x80 | (_unicode & 0x3F)));
+        } else if (_unicode >= 0xD800 && _unicode < 0xE000) {
+          put('?');
+        } else {
+          put(static_cast<char>(0xE0 | (_unicode >> 12)));
+          put(static_cast<char>(0x80 | ((_unicode >> 6) & 0x3F)));
+          put(static_cast<char>(0x80 | (_unicode & 0x3F)));
+        }
+        _state = InString;
+        break;
+      }
+
+      case Value:
+        switch (c) {
+          case '"':
+            beginValue(true);
+            _state = InString;
+            break;
+          case '{':
+          case '[':
+            if (_depth >= kMaxDepth) {
+              _state = Stopped;
+              break;
+            }
+            if (c == '{' && inObject() && strcmp(_key, "error") == 0 &&
+                _depth == 1) {
+              _errorDepth = _depth + 1;
+            }
+            if (c == '{') {
+              _containers |= 1UL << _depth;
+            } else {
+              _containers &= ~(1UL << _depth);
+            }
+            ++_depth;
+            _expectKey = c == '{';
+            _key[0] = '\0';
+            break;
+          case '}':
+          case ']':
+            if (_depth == 0) {
+              _state = Stopped;
+              break;
+            }
+            if (_depth == _errorDepth) {
+              _errorDepth = 0;
+            }
+            --_depth;
+            _expectKey = false;
+            break;
+          case ',':
+            _expectKey = inObject();
+            break;
+          case ':':
+          case ' ':
+          case '\t':
+          case '\r':
+          case '\n':
+            break;
+          default:
+            beginValue(false);
+            _state = Literal;
+            put(c);
+            break;
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef WAAVIS_JSON_H
+#define WAAVIS_JSON_H
+
+#include "Waavis.h"
+
+// Incremental JSON scanner for API responses. Bytes can be fed in blocks of
+// any size; it keeps no copy of the body and only captures the fields of
+// WaavisResponse, truncated to their fixed buffers. Malformed input stops
+// the scan but never fails it.
+class WaavisJsonScanner {
+public:
+  explicit WaavisJsonScanner(WaavisResponse &result);
+  void feed(const uint8_t *data, size_t len);
+
+private:
+  enum State : uint8_t { Value, InString, Escape, Unicode, Literal, Stopped };
+  enum Target : uint8_t { None, Key, MessageId, ErrorCode, Error, TopMessage };
+
+  WaavisResponse &_result;
+  State _state;
+  Target _target;
+  uint32_t _containers;  // one bit per depth, set for objects
+  uint8_t _depth;
+  uint8_t _errorDepth;
+  bool _expectKey;
+  bool _errorFromMessage;
+  char _key[20];
+  char *_out;
+  size_t _outCap;
+  size_t _outLen;
+  uint16_t _unicode;
+  uint8_t _unicodeDigits;
+
+  bool inObject() const;
+  void beginValue(bool isString);
+  void put(char c);
+  void endValue();
+  void literalChar(char c);
+};
+
+#endif
@@ -0,0 +1,419 @@
+#include "WaavisInternal.h"
+
+#if WAAVIS_ENABLE_OUTBOX
+
+// Journal layout: a sequence of records, each
+//   'W' | type | payload length (u16) | crc32(payload) (u32) | payload
+// where a message payload is
+//   id (u32) | method | path (u16 + bytes) | token (u16 + bytes) | body (u16 + bytes)
+// and an ack payload is the id (u32) of the message that was delivered.
+// Messages are delivered in file order, so the highest acked id marks
+// everything before it as done. A record that fails its length or CRC check
+// ends the journal; it is dropped by the next compaction.
+
+static const size_t kOutboxStageSize = 512;
+static const unsigned long kOutboxFlushDelayMs = 2000;
+static const size_t kOutboxCompactThreshold = 32;
+static const unsigned long kOutboxBackoffMinMs = 1000;
+static const unsigned long kOutboxBackoffMaxMs = 300000;
+static const uint8_t kRecordMagic = 'W';
+static const uint8_t kRecordMessage = 'M';
+static const uint8_t kRecordAck = 'A';
+static const size_t kRecordHeaderSize = 8;
+
+static void putU16(uint8_t *p, uint16_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  putU16(p, static_cast<uint16_t>(v));
+  putU16(p + 2, static_cast<uint16_t>(v >> 16));
+}
+
+static uint16_t getU16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t *p) {
+  return getU16(p) | (static_cast<uint32_t>(getU16(p + 2)) << 16);
+}
+
+struct OutboxRecord {
+  uint8_t type;
+  uint16_t length;
+  uint32_t id;
+};
+
+// Validates the record at the current position and leaves the file after it.
+static bool scanRecord(File &file, OutboxRecord &record) {
+  uint8_t header[kRecordHeaderSize];
+  if (file.read(header, sizeof(header)) != sizeof(header) ||
+      header[0] != kRecordMagic) {
+    return false;
+  }
+  record.type = header[1];
+  record.length = getU16(header + 2);
+  if (record.length < 4 ||
+      (record.type != kRecordMessage && record.type != kRecordAck)) {
+    return false;
+  }
+
+  uint8_t buffer[64];
+  uint32_t crc = 0xFFFFFFFFUL;
+  size_t remaining = record.length;
+  bool first = true;
+  while (remaining > 0) {
+    size_t n = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+    if (file.read(buffer, n) != n) {
+      return false;
+    }
+    if (first) {
+      record.id = getU32(buffer);
+      first = false;
+    }
+    crc = waavisCrc32(crc, buffer, n);
+    remaining -= n;
+  }
+  return ~crc == getU32(header + 4);
+}
+
+static bool takeField(const uint8_t *&p, const uint8_t *end, String &out) {
+  if (end - p < 2) {
+    return false;
+  }
+  uint16_t len = getU16(p);
+  p += 2;
+  if (end - p < len) {
+    return false;
+  }
+  out = "";
+  out.concat(reinterpret_cast<const char *>(p), len);
+  p += len;
+  return true;
+}
+
+bool WaavisClient::beginOutbox(fs::FS &fs, const char *path) {
+  WAAVIS_IO_LOCK();
+  if (_outboxStage == nullptr) {
+    _outboxStage = static_cast<uint8_t *>(malloc(kOutboxStageSize));
+    if (_outboxStage == nullptr) {
+      _lastError = "Out of memory";
+      return false;
+    }
+  }
+  _outboxFs = &fs;
+  _outboxPath = path;
+  _outboxStageLen = 0;
+  _outboxPending = 0;
+  _outboxAcked = 0;
+  _outboxReadPos = 0;
+  _outboxDeliveredId = 0;
+  _outboxNextId = 1;
+  _outboxBackoff = 0;
+  _outboxNextAttempt = millis();
+
+  // A crash during compaction leaves either both files (the copy may be
+  // incomplete) or only the finished copy.
+  String tmpPath = _outboxPath + ".tmp";
+  if (fs.exists(tmpPath)) {
+    if (fs.exists(_outboxPath)) {
+      fs.remove(tmpPath);
+    } else {
+      fs.rename(tmpPath, _outboxPath);
+    }
+  }
+
+  File file = fs.open(_outboxPath, "r");
+  if (!file) {
+    return true;
+  }
+
+  OutboxRecord record;
+  uint32_t validEnd = 0;
+  size_t records = 0;
+  while (scanRecord(file, record)) {
+    validEnd = file.position();
+    ++records;
+    if (record.type == kRecordAck) {
+      if (record.id > _outboxDeliveredId) {
+        _outboxDeliveredId = record.id;
+      }
+    } else if (record.id >= _outboxNextId) {
+      _outboxNextId = record.id + 1;
+    }
+  }
+  bool torn = validEnd < file.size();
+
+  file.seek(0);
+  bool foundFirst = false;
+  uint32_t start = 0;
+  while (file.position() < validEnd && scanRecord(file, record)) {
+    if (record.type == kRecordMessage && record.id > _outboxDeliveredId) {
+      if (!foundFirst) {
+        _outboxReadPos = start;
+        foundFirst = true;
+      }
+      ++_outboxPending;
+    } else {
+      ++_outboxAcked;
+    }
+    start = file.position();
+  }
+  file.close();
+
+  if (_outboxPending == 0 && records > 0) {
+    fs.remove(_outboxPath);
+    _outboxReadPos = 0;
+    _outboxAcked = 0;
+  } else if (torn) {
+    WAAVIS_TRACE(ERROR, OutboxTornRecord, 0);
+    compactOutbox();
+  }
+  return true;
+}
+
+size_t WaavisClient::outboxPending() const {
+  return _outboxPending;
+}
+
+bool WaavisClient::stageOutbox(uint8_t type, const uint8_t *payload, size_t len) {
+  uint8_t header[kRecordHeaderSize];
+  header[0] = kRecordMagic;
+  header[1] = type;
+  putU16(header + 2, static_cast<uint16_t>(len));
+  putU32(header + 4, ~waavisCrc32(0xFFFFFFFFUL, payload, len));
+
+  if (_outboxStageLen + sizeof(header) + len > kOutboxStageSize) {
+    flushOutbox();
+  }
+  if (sizeof(header) + len > kOutboxStageSize) {
+    File file = _outboxFs->open(_outboxPath, "a");
+    if (!file) {
+      return false;
+    }
+    bool ok = file.write(header, sizeof(header)) == sizeof(header) &&
+              file.write(payload, len) == len;
+    file.close();
+    return ok;
+  }
+
+  if (_outboxStageLen == 0) {
+    _outboxStagedAt = millis();
+  }
+  memcpy(_outboxStage + _outboxStageLen, header, sizeof(header));
+  memcpy(_outboxStage + _outboxStageLen + sizeof(header), payload, len);
+  _outboxStageLen += sizeof(header) + len;
+  return true;
+}
+
+void WaavisClient::flushOutbox() {
+  WAAVIS_IO_LOCK();
+  if (_outboxFs == nullptr || _outboxStageLen == 0) {
+    return;
+  }
+  File file = _outboxFs->open(_outboxPath, "a");
+  if (!file) {
+    WAAVIS_TRACE(ERROR, OutboxOpenFailed, 0);
+    return;
+  }
+  file.write(_outboxStage, _outboxStageLen);
+  file.close();
+  _outboxStageLen = 0;
+}
+
+bool WaavisClient::queueOutbox(const char *method, const String &path,
+                               const String &token, const String &body) {
+  size_t len = 4 + 1 + 2 + path.length() + 2 + token.length() + 2 + body.length();
+  if (len > 0xFFFF) {
+    _lastError = "Message too large for outbox";
+    return false;
+  }
+  uint8_t *payload = static_cast<uint8_t *>(malloc(len));
+  if (payload == nullptr) {
+    _lastError = "Out of memory";
+    return false;
+  }
+
+  uint32_t id = _outboxNextId++;
+  uint8_t *p = payload;
+  putU32(p, id);
+  p += 4;
+  *p++ = static_cast<uint8_t>(method[0]);
+  const String *fields[] = {&path, &token, &body};
+  for (const String *field : fields) {
+    putU16(p, static_cast<uint16_t>(field->length()));
+    memcpy(p + 2, field->c_str(), field->length());
+    p += 2 + field->length();
+  }
+
+  bool ok = stageOutbox(kRecordMessage, payload, len);
+  free(payload);
+  if (!ok) {
+    _lastError = "Outbox write failed";
+    return false;
+  }
+  ++_outboxPending;
+  _lastError = "";
+  WAAVIS_TRACE(INFO, OutboxQueued, _outboxPending);
+  return true;
+}
+
+bool WaavisClient::compactOutbox() {
+  flushOutbox();
+  String tmpPath = _outboxPath + ".tmp";
+  File source = _outboxFs->open(_outboxPath, "r");
+  if (!source) {
+    return false;
+  }
+  File target = _outboxFs->open(tmpPath, "w");
+  if (!target) {
+    source.close();
+    return false;
+  }
+
+  OutboxRecord record;
+  uint32_t start = 0;
+  uint8_t buffer[64];
+  while (scanRecord(source, record)) {
+    uint32_t end = source.position();
+    if (record.type == kRecordMessage && record.id > _outboxDeliveredId) {
+      source.seek(start);
+      size_t remaining = end - start;
+      while (remaining > 0) {
+        size_t n = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+        source.read(buffer, n);
+        target.write(buffer, n);
+        remaining -= n;
+      }
+    }
+    start = end;
+  }
+  source.close();
+  target.close();
+
+  _outboxFs->remove(_outboxPath);
+  _outboxFs->rename(tmpPath, _outboxPath);
+  _outboxReadPos = 0;
+  _outboxAcked = 0;
+  return true;
+}
+
+void WaavisClient::processOutbox() {
+  WAAVIS_IO_LOCK();
+  if (_outboxFs == nullptr) {
+    return;
+  }
+  if (_outboxStageLen > 0 && millis() - _outboxStagedAt >= kOutboxFlushDelayMs) {
+    flushOutbox();
+  }
+  if (_outboxPending == 0 || !linkUp() || sendInProgress() ||
+      static_cast<long>(millis() - _outboxNextAttempt) < 0) {
+    return;
+  }
+  flushOutbox();
+
+  File file = _outboxFs->open(_outboxPath, "r");
+  if (!file) {
+    _outboxPending = 0;
+    return;
+  }
+  file.seek(_outboxReadPos);
+
+  // Skip acks and delivered messages up to the next pending message.
+  uint8_t header[kRecordHeaderSize];
+  uint8_t *payload = nullptr;
+  uint32_t id = 0;
+  while (payload == nullptr) {
+    if (file.read(header, sizeof(header)) != sizeof(header) ||
+        header[0] != kRecordMagic) {
+      break;
+    }
+    uint16_t len = getU16(header + 2);
+    uint8_t idBytes[4];
+    if (len < 4 || file.read(idBytes, 4) != 4) {
+      break;
+    }
+    id = getU32(idBytes);
+    if (header[1] != kRecordMessage || id <= _outboxDeliveredId) {
+      file.seek(file.position() + len - 4);
+      continue;
+    }
+    payload = static_cast<uint8_t *>(malloc(len));
+    if (payload == nullptr) {
+      file.close();
+      return;
+    }
+    memcpy(payload, idBytes, 4);
+    if (file.read(payload + 4, len - 4) != static_cast<size_t>(len - 4) ||
+        ~waavisCrc32(0xFFFFFFFFUL, payload, len) != getU32(header + 4)) {
+      free(payload);
+      payload = nullptr;
+      break;
+    }
+  }
+  uint32_t nextPos = file.position();
+  file.close();
+
+  if (payload == nullptr) {
+    WAAVIS_TRACE(ERROR, OutboxTruncated, 0);
+    _outboxPending = 0;
+    compactOutbox();
+    return;
+  }
+
+  String path;
+  String token;
+  String body;
+  const uint8_t *p = payload + 5;
+  const uint8_t *end = payload + getU16(header + 2);
+  bool parsed = takeField(p, end, path) && takeField(p, end, token) &&
+                takeField(p, end, body);
+  char method = static_cast<char>(payload[4]);
+  free(payload);
+
+  bool done = !parsed;
+  if (parsed) {
+    bool isGet = method == 'G';
+    done = sendRequest(isGet ? "GET" : "POST", path, token,
+                       isGet ? "" : kFormContentType, body);
+    // The server rejected the request itself; retrying cannot help.
+    if (!done && _lastResponse.status >= 400 &&
+        _lastResponse.status < 500) {
+      WAAVIS_TRACE(ERROR, OutboxDropped, _lastResponse.status);
+      done = true;
+    }
+  }
+
+  if (!done) {
+    _outboxBackoff = _outboxBackoff == 0 ? kOutboxBackoffMinMs : _outboxBackoff * 2;
+    if (_outboxBackoff > kOutboxBackoffMaxMs) {
+      _outboxBackoff = kOutboxBackoffMaxMs;
+    }
+    _outboxNextAttempt = millis() + _outboxBackoff / 2 + random(_outboxBackoff / 2 + 1);
+    return;
+  }
+
+  _outboxBackoff = 0;
+  _outboxNextAttempt = millis();
+  _outboxDeliveredId = id;
+  _outboxReadPos = nextPos;
+  --_outboxPending;
+  ++_outboxAcked;
+  if (_outboxPending == 0) {
+    _outboxStageLen = 0;
+    _outboxFs->remove(_outboxPath);
+    _outboxReadPos = 0;
+    _outboxAcked = 0;
+    return;
+  }
+
+  uint8_t ack[4];
+  putU32(ack, id);
+  stageOutbox(kRecordAck, ack, sizeof(ack));
+  if (_outboxAcked >= kOutboxCompactThreshold) {
+    compactOutbox();
+  }
+}
+
+#endif
@@ -0,0 +1,305 @@
+#include "WaavisInternal.h"
+
+#if WAAVIS_ENABLE_MEDIA
+
+#if defined(ESP32)
+#include <freertos/stream_buffer.h>
+
+static const size_t kRelayBufferSize = 8192;
+
+// Carries the download from the producer task to the upload loop. Only
+// available() and readBytes() are used by the upload.
+class RelayStream : public Stream {
+public:
+  explicit RelayStream(StreamBufferHandle_t buffer) : _buffer(buffer) {}
+
+  int available() override {
+    return static_cast<int>(xStreamBufferBytesAvailable(_buffer));
+  }
+
+  int read() override {
+    uint8_t c;
+    return xStreamBufferReceive(_buffer, &c, 1, 0) == 1 ? c : -1;
+  }
+
+  size_t readBytes(char *buffer, size_t length) override {
+    return xStreamBufferReceive(_buffer, buffer, length, 0);
+  }
+
+  int peek() override {
+    return -1;
+  }
+
+  size_t write(uint8_t) override {
+    return 0;
+  }
+
+private:
+  StreamBufferHandle_t _buffer;
+};
+
+struct RelayJob {
+  Client *source;
+  StreamBufferHandle_t buffer;
+  size_t expected;
+  unsigned long idleTimeout;
+  volatile bool done;
+  volatile bool abort;
+  SemaphoreHandle_t exited;
+};
+
+// Downloads into the ring buffer while the caller uploads from it; blocks
+// when the buffer is full, so at most kRelayBufferSize bytes are held.
+static void relayTask(void *arg) {
+  RelayJob &job = *static_cast<RelayJob *>(arg);
+  uint8_t chunk[512];
+  size_t received = 0;
+  unsigned long lastData = millis();
+  while (!job.abort && received < job.expected) {
+    int available = job.source->available();
+    if (available > 0) {
+      size_t want = job.expected - received;
+      if (want > sizeof(chunk)) {
+        want = sizeof(chunk);
+      }
+      int n = job.source->read(chunk, want);
+      size_t sent = 0;
+      while (n > 0 && sent < static_cast<size_t>(n) && !job.abort) {
+        sent += xStreamBufferSend(job.buffer, chunk + sent, n - sent,
+                                  pdMS_TO_TICKS(100));
+      }
+      received += sent;
+      lastData = millis();
+      continue;
+    }
+    if (!job.source->connected() || millis() - lastData > job.idleTimeout) {
+      break;
+    }
+    vTaskDelay(1);
+  }
+  job.done = true;
+  xSemaphoreGive(job.exited);
+  vTaskDelete(nullptr);
+}
+#else
+// Single-threaded relay: the source socket's receive window is the bounded
+// buffer, and TCP keeps downloading into it while the upload writes.
+class RelayStream : public Stream {
+public:
+  RelayStream(Client &source, size_t expected)
+      : _source(source), _remaining(expected), _done(false) {}
+
+  int available() override {
+    int n = _source.available();
+    if (n <= 0 && !_source.connected()) {
+      _done = true;
+    }
+    if (n > 0 && static_cast<size_t>(n) > _remaining) {
+      n = static_cast<int>(_remaining);
+    }
+    return n;
+  }
+
+  int read() override {
+    if (_remaining == 0) {
+      return -1;
+    }
+    int c = _source.read();
+    if (c >= 0) {
+      --_remaining;
+    }
+    return c;
+  }
+
+  size_t readBytes(char *buffer, size_t length) override {
+    if (length > _remaining) {
+      length = _remaining;
+    }
+    int n = _source.read(reinterpret_cast<uint8_t *>(buffer), length);
+    if (n <= 0) {
+      return 0;
+    }
+    _remaining -= n;
+    if (_remaining == 0) {
+      _done = true;
+    }
+    return static_cast<size_t>(n);
+  }
+
+  int peek() override {
+    return _source.peek();
+  }
+
+  size_t write(uint8_t) override {
+    return 0;
+  }
+
+  const volatile bool *done() const {
+    return &_done;
+  }
+
+private:
+  Client &_source;
+  size_t _remaining;
+  volatile bool _done;
+};
+#endif
+
+static String fileNameFromPath(const String &path) {
+  int end = path.indexOf('?');
+  String name = end >= 0 ? path.substring(0, end) : path;
+  int slash = name.lastIndexOf('/');
+  name = name.substring(slash + 1);
+  return name.length() > 0 ? name : String("file");
+}
+
+bool WaavisClient::sendChatMediaFromUrl(const String &token, const String &to,
+                                        const String &caption, bool typing,
+                                        const String &type,
+                                        const String &sourceUrl) {
+  WAAVIS_IO_LOCK();
+  if (stepBusy()) {
+    return false;
+  }
+  // The source is downloaded over WiFi even when setTransport() carries the
+  // API, so linkUp() is not enough here.
+  if (WiFi.status() != WL_CONNECTED) {
+    _lastError = "WiFi not connected";
+    return false;
+  }
+
+  bool https = false;
+  uint16_t port = 0;
+  String path;
+  String host = waavisParseHost(sourceUrl, https, port, path);
+  if (host.length() == 0) {
+    _lastError = "Invalid source URL";
+    return false;
+  }
+  if (path.length() == 0) {
+    path = "/";
+  }
+
+  WiFiClient plainSource;
+  Client *source = &plainSource;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  BearSSL::WiFiClientSecure secureSource;
+#elif WAAVIS_ENABLE_TLS
+  WiFiClientSecure secureSource;
+#endif
+  if (https) {
+#if WAAVIS_ENABLE_TLS
+    // Sources are typically LAN devices with self-signed certificates.
+    secureSource.setInsecure();
+#if defined(ESP8266)
+    // A second TLS engine next to the API connection; keep it small. The
+    // probe is its own connection, so ask once per source.
+    if (host != _relayProbeHost || port != _relayProbePort) {
+      _relayFragmentSupported =
+          BearSSL::WiFiClientSecure::probeMaxFragmentLength(host.c_str(), port, 1024);
+      _relayProbeHost = host;
+      _relayProbePort = port;
+    }
+    if (_relayFragmentSupported) {
+      secureSource.setBufferSizes(1024, 512);
+    }
+#endif
+    source = &secureSource;
+#else
+    _lastError = "HTTPS support disabled";
+    return false;
+#endif
+  }
+
+  // The deadline starts here; the upload below keeps it.
+  timingBegin();
+  source->setTimeout(waitBudget(kConnectTimeoutMs));
+  if (!source->connect(host.c_str(), port)) {
+    _lastError = waitBudget(1) == 0 ? "Source timeout" : "Source connect failed";
+    return false;
+  }
+  // HTTP/1.0 rules out a chunked response, so the body is either
+  // Content-Length bytes or everything up to the close.
+  String request = "GET " + path + " HTTP/1.0\r\nHost: " + host +
+                   "\r\nUser-Agent: waavis-arduino\r\nConnection: close\r\n\r\n";
+  if (source->write(reinterpret_cast<const uint8_t *>(request.c_str()), request.length()) !=
+      request.length()) {
+    source->stop();
+    _lastError = "Source connect failed";
+    return false;
+  }
+
+  char line[128];
+  int status = -1;
+  if (waavisReadLine(*source, line, sizeof(line), waitBudget(_streamIdleTimeout)) > 0 &&
+      strncmp(line, "HTTP/", 5) == 0) {
+    const char *space = strchr(line, ' ');
+    status = space != nullptr ? atoi(space + 1) : -1;
+  }
+  size_t size = WAAVIS_UNKNOWN_SIZE;
+  int len;
+  while ((len = waavisReadLine(*source, line, sizeof(line), waitBudget(_streamIdleTimeout))) > 0) {
+    const char *value = nullptr;
+    if (waavisHeaderIs(line, "Content-Length", &value)) {
+      size = static_cast<size_t>(strtoul(value, nullptr, 10));
+    }
+  }
+  if (status != 200 || len < 0) {
+    source->stop();
+    if (waitBudget(1) == 0) {
+      _lastError = "Source timeout";
+    } else {
+      _lastError = status > 0 ? "Source HTTP " + String(status) : "Source response invalid";
+    }
+    return false;
+  }
+  if (size == 0) {
+    source->stop();
+    _lastError = "File is empty";
+    return false;
+  }
+
+  WAAVIS_TRACE(INFO, RelayStart, size == WAAVIS_UNKNOWN_SIZE ? -1 : static_cast<int32_t>(size));
+  String fileName = fileNameFromPath(path);
+  bool ok = false;
+#if defined(ESP32)
+  RelayJob job;
+  job.source = source;
+  job.buffer = xStreamBufferCreate(kRelayBufferSize, 1);
+  job.expected = size;
+  job.idleTimeout = _streamIdleTimeout;
+  job.done = false;
+  job.abort = false;
+  job.exited = xSemaphoreCreateBinary();
+  if (job.buffer == nullptr || job.exited == nullptr ||
+      xTaskCreatePinnedToCore(relayTask, "waavis-relay", 3072, &job,
+                              uxTaskPriorityGet(nullptr), nullptr,
+                              xPortGetCoreID()) != pdPASS) {
+    _lastError = "Out of memory";
+  } else {
+    RelayStream stream(job.buffer);
+    _holdDeadline = true;
+    ok = sendChatMediaStreamChunked(token, to, caption, typing, type, stream,
+                                    size, fileName, &job.done);
+    _holdDeadline = false;
+    job.abort = true;
+    xSemaphoreTake(job.exited, portMAX_DELAY);
+  }
+  if (job.buffer != nullptr) {
+    vStreamBufferDelete(job.buffer);
+  }
+  if (job.exited != nullptr) {
+    vSemaphoreDelete(job.exited);
+  }
+#else
+  RelayStream stream(*source, size);
+  _holdDeadline = true;
+  ok = sendChatMediaStreamChunked(token, to, caption, typing, type, stream, size,
+                                  fileName, stream.done());
+  _holdDeadline = false;
+#endif
+  source->stop();
+  return ok;
+}
+
+#endif
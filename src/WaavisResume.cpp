@@ -0,0 +1,136 @@
+#include "WaavisInternal.h"
+
+// Connection facts that survive deep sleep. On ESP8266 they live in the RTC
+// user memory (the caller picks the slot); on ESP32 in RTC slow memory.
+struct ResumeState {
+  uint32_t magic;
+  uint32_t crc;  // over everything after this field
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t tlsFragmentSupported;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t serverIp;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  BearSSL::Session tlsSession;
+#endif
+};
+
+static const uint32_t kResumeMagic = 0x57525331UL;  // "WRS1"
+
+#if defined(ESP8266)
+// The RTC user area is 512 bytes, addressed in 4-byte blocks.
+static_assert(sizeof(ResumeState) <= 512 - 4 * 96,
+              "resume state must fit the default RTC slot");
+#else
+RTC_DATA_ATTR static ResumeState rtcResumeState;
+#endif
+
+static uint32_t resumeCrc(const ResumeState &state) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&state);
+  size_t offset = offsetof(ResumeState, crc) + sizeof(state.crc);
+  return ~waavisCrc32(0xFFFFFFFFUL, bytes + offset, sizeof(state) - offset);
+}
+
+static bool loadState(ResumeState &state, uint32_t rtcSlot) {
+#if defined(ESP8266)
+  if (!ESP.rtcUserMemoryRead(rtcSlot, reinterpret_cast<uint32_t *>(&state),
+                             sizeof(state))) {
+    return false;
+  }
+#else
+  (void)rtcSlot;
+  memcpy(&state, &rtcResumeState, sizeof(state));
+#endif
+  return state.magic == kResumeMagic && state.crc == resumeCrc(state);
+}
+
+WaavisWakeReport WaavisClient::wakeReport() const {
+  WAAVIS_IO_LOCK();
+  return _wakeReport;
+}
+
+bool WaavisClient::resumeWiFi(const char *ssid, const char *password,
+                              unsigned long timeoutMs, uint32_t rtcSlot) {
+  WAAVIS_IO_LOCK();
+  memset(&_wakeReport, 0, sizeof(_wakeReport));
+  _wakeReport.active = true;
+  _resumeSlot = rtcSlot;
+
+  ResumeState state;
+  bool restored = loadState(state, rtcSlot);
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+
+  unsigned long start = millis();
+  if (restored) {
+    // A static lease skips DHCP; BSSID and channel skip the scan.
+    WiFi.config(IPAddress(state.ip), IPAddress(state.gateway),
+                IPAddress(state.subnet), IPAddress(state.dns));
+    WiFi.begin(ssid, password, state.channel, state.bssid, true);
+    while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs / 2) {
+      delay(5);
+    }
+    if (WiFi.status() == WL_CONNECTED) {
+      _wakeReport.fastWiFi = true;
+      _resumeServerIp = state.serverIp;
+      _wakeReport.serverIpRestored = state.serverIp != 0;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+      _tlsSession = state.tlsSession;
+      _tlsFragmentSupported = state.tlsFragmentSupported;
+      _wakeReport.tlsSessionRestored = true;
+#endif
+    } else {
+      // The access point moved or the lease is gone: fall back to a normal join.
+      WAAVIS_TRACE(INFO, ResumeFailed, 0);
+      WiFi.disconnect();
+      WiFi.config(IPAddress(), IPAddress(), IPAddress());
+    }
+  }
+  if (!_wakeReport.fastWiFi) {
+    WiFi.begin(ssid, password);
+    while (WiFi.status() != WL_CONNECTED && millis() - start < timeoutMs) {
+      delay(5);
+    }
+  }
+
+  if (WiFi.status() != WL_CONNECTED) {
+    _lastError = "WiFi not connected";
+    return false;
+  }
+  _wakeReport.wifiMs = millis();
+  return true;
+}
+
+void WaavisClient::saveResumeState() {
+  WAAVIS_IO_LOCK();
+  if (WiFi.status() != WL_CONNECTED) {
+    return;
+  }
+
+  ResumeState state;
+  memset(static_cast<void *>(&state), 0, sizeof(state));
+  state.magic = kResumeMagic;
+  memcpy(state.bssid, WiFi.BSSID(), sizeof(state.bssid));
+  state.channel = static_cast<uint8_t>(WiFi.channel());
+  state.ip = static_cast<uint32_t>(WiFi.localIP());
+  state.gateway = static_cast<uint32_t>(WiFi.gatewayIP());
+  state.subnet = static_cast<uint32_t>(WiFi.subnetMask());
+  state.dns = static_cast<uint32_t>(WiFi.dnsIP());
+  state.serverIp = _serverIp;
+  state.tlsFragmentSupported = -1;
+#if WAAVIS_ENABLE_TLS && defined(ESP8266)
+  state.tlsSession = _tlsSession;
+  state.tlsFragmentSupported = _tlsFragmentSupported;
+#endif
+  state.crc = resumeCrc(state);
+
+#if defined(ESP8266)
+  ESP.rtcUserMemoryWrite(_resumeSlot, reinterpret_cast<uint32_t *>(&state),
+                         sizeof(state));
+#else
+  memcpy(&rtcResumeState, &state, sizeof(state));
+#endif
+}
@@ -0,0 +1,116 @@
+#include "WaavisInternal.h"
+
+#if WAAVIS_ENABLE_MEMORY_PROFILE && defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+WaavisTiming WaavisClient::lastTiming() const {
+  WAAVIS_IO_LOCK();
+  return _lastTiming;
+}
+
+WaavisEndpointStats WaavisClient::stats(WaavisEndpoint endpoint) const {
+  WAAVIS_IO_LOCK();
+  return _stats[static_cast<uint8_t>(endpoint)];
+}
+
+void WaavisClient::resetStats() {
+  memset(_stats, 0, sizeof(_stats));
+}
+
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+WaavisMemoryProfile WaavisClient::lastMemoryProfile() const {
+  WAAVIS_IO_LOCK();
+  return _memoryProfile;
+}
+
+static void readHeap(uint32_t &freeBytes, uint32_t &largest) {
+#if defined(ESP8266)
+  uint8_t fragmentation;
+  ESP.getHeapStats(&freeBytes, &largest, &fragmentation);
+#else
+  freeBytes = ESP.getFreeHeap();
+  largest = ESP.getMaxAllocHeap();
+#endif
+}
+
+static int32_t allocatedBlocks() {
+#if defined(ESP32)
+  multi_heap_info_t info;
+  heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+  return static_cast<int32_t>(info.allocated_blocks);
+#else
+  return 0;
+#endif
+}
+
+void WaavisClient::sampleMemory() {
+  uint32_t freeBytes;
+  uint32_t largest;
+  readHeap(freeBytes, largest);
+  if (freeBytes < _memoryProfile.freeMin) {
+    _memoryProfile.freeMin = freeBytes;
+  }
+  if (largest < _memoryProfile.largestMin) {
+    _memoryProfile.largestMin = largest;
+  }
+}
+#endif
+
+void WaavisClient::timingBegin() {
+  memset(&_lastTiming, 0, sizeof(_lastTiming));
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  readHeap(_memoryProfile.freeBefore, _memoryProfile.largestBefore);
+  _memoryProfile.freeMin = _memoryProfile.freeBefore;
+  _memoryProfile.largestMin = _memoryProfile.largestBefore;
+  _blocksBefore = allocatedBlocks();
+#endif
+  _timingStart = micros();
+  // Each send is also the unit the deadline applies to.
+  if (!_holdDeadline) {
+    _deadlineStart = millis();
+  }
+}
+
+void WaavisClient::markPhase(WaavisPhase phase) {
+  _lastTiming.at[static_cast<uint8_t>(phase)] = micros() - _timingStart;
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  sampleMemory();
+#endif
+}
+
+void WaavisClient::timingEnd(WaavisEndpoint endpoint, bool ok) {
+  markPhase(WaavisPhase::Done);
+#if WAAVIS_ENABLE_MEMORY_PROFILE
+  readHeap(_memoryProfile.freeAfter, _memoryProfile.largestAfter);
+  _memoryProfile.blocksDelta = allocatedBlocks() - _blocksBefore;
+#endif
+  if (ok && _wakeReport.active && _wakeReport.ackMs == 0) {
+    _wakeReport.ackMs = millis();
+  }
+  WaavisEndpointStats &stats = _stats[static_cast<uint8_t>(endpoint)];
+  ++stats.count;
+  if (!ok) {
+    ++stats.failures;
+  }
+
+  uint32_t previous = 0;
+  for (size_t i = 0; i < WAAVIS_PHASE_COUNT; ++i) {
+    uint32_t at = _lastTiming.at[i];
+    if (at == 0) {
+      continue;
+    }
+    stats.phaseTotalMs[i] += (at - previous) / 1000;
+    previous = at;
+  }
+
+  uint32_t totalMs = _lastTiming.at[WAAVIS_PHASE_COUNT - 1] / 1000;
+  if (totalMs > stats.maxMs) {
+    stats.maxMs = totalMs;
+  }
+  size_t bucket = 0;
+  while (bucket + 1 < WAAVIS_HISTOGRAM_BUCKETS && totalMs >= (16UL << bucket)) {
+    ++bucket;
+  }
+  ++stats.histogram[bucket];
+}
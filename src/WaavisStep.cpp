@@ -0,0 +1,368 @@
+#include "WaavisInternal.h"
+#include "WaavisForm.h"
+
+// Step-based sends: the blocking request path cut into slices that poll()
+// runs one after another within a time budget. Each slice writes at most one
+// upload buffer, so loop() keeps running between slices.
+
+bool WaavisClient::beginStep(WaavisEndpoint endpoint, const char *path,
+                             const String &token, const String &contentType,
+                             const String &head, const uint8_t *data, Stream *file,
+                             size_t dataSize, const String &tail) {
+  if (_step.state != StepState::Idle) {
+    _lastError = "Send in progress";
+    return false;
+  }
+  if (!linkUp()) {
+    _lastError = "WiFi not connected";
+    return false;
+  }
+
+#if defined(ESP32)
+  // The connection belongs to this send until it ends; keep the async worker
+  // off it in between polls. Never wait for it here: that would block loop().
+  if (_ioLock != nullptr && xSemaphoreTakeRecursive(_ioLock, 0) != pdTRUE) {
+    _lastError = "Send in progress";
+    return false;
+  }
+  _step.locked = _ioLock != nullptr;
+#else
+  _step.locked = false;
+#endif
+  _step.endpoint = endpoint;
+  _step.path = path;
+  _step.token = token;
+  _step.contentType = contentType;
+  _step.head = head;
+  _step.tail = tail;
+  _step.data = data;
+  _step.file = file;
+  _step.dataSize = dataSize;
+  _step.piece = 0;
+  _step.offset = 0;
+  _step.client = nullptr;
+  _step.reused = false;
+  _step.since = 0;
+  _step.state = StepState::Connect;
+  _lastResponse.status = -1;
+  timingBegin();
+  return true;
+}
+
+bool WaavisClient::beginChatPost(const String &token, const String &to,
+                                 const String &message, bool typing) {
+  WaavisForm form;
+  form.add("to", to);
+  form.add("message", message);
+  form.add("typing", typing ? "true" : "false");
+  String body;
+  form.appendTo(body);
+  return beginStep(WaavisEndpoint::SendChat, "/v1/send_chat", token, kFormContentType,
+                   body, nullptr, nullptr, 0, String());
+}
+
+#if WAAVIS_ENABLE_MEDIA
+bool WaavisClient::beginChatMediaBuffer(const String &token, const String &to,
+                                        const String &message, bool typing,
+                                        const String &type, const uint8_t *data,
+                                        size_t dataSize, const String &fileName) {
+  if (dataSize == 0) {
+    _lastError = "File is empty";
+    return false;
+  }
+  String boundary = "----WaavisBoundary" + String(millis());
+  return beginStep(WaavisEndpoint::SendChatMedia, "/v1/send_chat_media", token,
+                   "multipart/form-data; boundary=" + boundary,
+                   waavisMediaToPart(boundary, to) +
+                       waavisMediaCommonParts(boundary, message, typing, type, fileName),
+                   data, nullptr, dataSize, "\r\n--" + boundary + "--\r\n");
+}
+
+bool WaavisClient::beginChatMedia(const String &token, const String &to,
+                                  const String &message, bool typing,
+                                  const String &type, Stream &file,
+                                  size_t fileSize, const String &fileName) {
+  if (fileSize == 0) {
+    _lastError = "File is empty";
+    return false;
+  }
+  if (fileSize == WAAVIS_UNKNOWN_SIZE) {
+    _lastError = "File size required";
+    return false;
+  }
+  String boundary = "----WaavisBoundary" + String(millis());
+  return beginStep(WaavisEndpoint::SendChatMedia, "/v1/send_chat_media", token,
+                   "multipart/form-data; boundary=" + boundary,
+                   waavisMediaToPart(boundary, to) +
+                       waavisMediaCommonParts(boundary, message, typing, type, fileName),
+                   nullptr, &file, fileSize, "\r\n--" + boundary + "--\r\n");
+}
+#endif
+
+bool WaavisClient::sendInProgress() const {
+  return _step.state != StepState::Idle;
+}
+
+// The blocking sends share the connection with the step send; until poll()
+// ends it they fail instead of writing into the middle of its request.
+bool WaavisClient::stepBusy() {
+  if (_step.state == StepState::Idle) {
+    return false;
+  }
+  _lastError = "Send in progress";
+  return true;
+}
+
+void WaavisClient::cancel() {
+  if (_step.state == StepState::Idle) {
+    return;
+  }
+  stop();
+  _lastError = "Send cancelled";
+  stepFinish(false);
+}
+
+WaavisPollResult WaavisClient::poll(unsigned long budgetMs) {
+  if (_step.state == StepState::Idle) {
+    return WaavisPollResult::Idle;
+  }
+  unsigned long start = millis();
+  WaavisPollResult result;
+  bool waiting = false;
+  do {
+    result = stepOnce(waiting);
+  } while (result == WaavisPollResult::InProgress && !waiting &&
+           millis() - start < budgetMs);
+  return result;
+}
+
+// Runs one slice. waiting is set when the send is blocked on the file or the
+// server and spinning would only burn the budget.
+WaavisPollResult WaavisClient::stepOnce(bool &waiting) {
+  // A non-blocking transport takes only what fits without waiting.
+  size_t room = kUploadBufferSize;
+  if (_transportNonBlocking &&
+      (_step.state == StepState::Head || _step.state == StepState::Body)) {
+    int writable = _step.client->availableForWrite();
+    if (writable <= 0) {
+      return stepWaitWritable(waiting);
+    }
+    if (static_cast<size_t>(writable) < room) {
+      room = static_cast<size_t>(writable);
+    }
+  }
+
+  switch (_step.state) {
+    case StepState::Connect: {
+      bool reused = false;
+      _step.client = openConnection(reused);
+      if (_step.client == nullptr) {
+        return stepFinish(false);
+      }
+      _step.reused = reused;
+      _step.request = String();
+      _step.offset = 0;
+      _step.since = millis();
+      _step.state = StepState::Head;
+      return WaavisPollResult::InProgress;
+    }
+
+    case StepState::Head: {
+      long contentLength = static_cast<long>(_step.head.length() + _step.dataSize +
+                                             _step.tail.length());
+      if (_transportNonBlocking) {
+        if (_step.request.length() == 0) {
+          if (!_step.reused) {
+            markPhase(WaavisPhase::Connect);
+          }
+          _step.request = requestHead("POST", _step.path, _step.token, _step.contentType,
+                                      contentLength);
+        }
+        size_t left = _step.request.length() - _step.offset;
+        size_t n = left < room ? left : room;
+        if (!waavisWriteAll(*_step.client,
+                            reinterpret_cast<const uint8_t *>(_step.request.c_str()) +
+                                _step.offset,
+                            n)) {
+          return stepFail(!_step.client->connected());
+        }
+        _step.offset += n;
+        _step.since = millis();
+        if (_step.offset < _step.request.length()) {
+          return WaavisPollResult::InProgress;
+        }
+        _step.request = String();
+      } else if (!writeRequestHead(*_step.client, "POST", _step.path, _step.token,
+                                   _step.contentType, contentLength)) {
+        return stepFail(!_step.client->connected());
+      }
+      markPhase(WaavisPhase::HeadersSent);
+      beginUpload(_step.dataSize);
+      _step.piece = 0;
+      _step.offset = 0;
+      _step.since = millis();
+      _step.state = StepState::Body;
+      return WaavisPollResult::InProgress;
+    }
+
+    case StepState::Body:
+#if WAAVIS_ENABLE_MEDIA
+      if (_step.piece == 1 && _step.file != nullptr && _step.file->available() <= 0) {
+        if (millis() - _step.since > _streamIdleTimeout) {
+          // The announced length cannot be met; the connection is unusable.
+          stop();
+          _lastError = "Incomplete read";
+          return stepFinish(false);
+        }
+        waiting = true;
+        return WaavisPollResult::InProgress;
+      }
+#endif
+      if (!stepWriteBody(room)) {
+        return stepFail(!_step.client->connected());
+      }
+      _step.since = millis();
+      if (_step.piece == 3) {
+        markPhase(WaavisPhase::BodySent);
+        endUpload();
+        _step.since = millis();
+        _step.state = StepState::Response;
+      }
+      return WaavisPollResult::InProgress;
+
+    case StepState::Response:
+      if (_step.client->available() <= 0) {
+        if (!_step.client->connected()) {
+          return stepFail(true);
+        }
+        if (millis() - _step.since > kResponseTimeoutMs || waitBudget(1) == 0) {
+          return stepFail(false);
+        }
+        waiting = true;
+        return WaavisPollResult::InProgress;
+      }
+      // The response is a small JSON object that normally arrives in one
+      // segment, so reading it to the end does not block for long.
+      if (!readResponse(*_step.client)) {
+        return stepFail(_closedUnanswered);
+      }
+      return stepFinish(finishResponse());
+
+    default:
+      return WaavisPollResult::Idle;
+  }
+}
+
+// Writes up to room bytes (at most one upload buffer) of the body: head,
+// then the payload, then tail (pieces 0-2). piece becomes 3 once everything
+// is written.
+bool WaavisClient::stepWriteBody(size_t room) {
+  if (waitBudget(1) == 0) {
+    return false;
+  }
+  Client &client = *_step.client;
+  if (_step.piece == 1) {
+    size_t left = _step.dataSize - _step.offset;
+    size_t n = left < room ? left : room;
+    if (_step.file != nullptr) {
+      uint8_t buffer[kUploadBufferSize];
+      size_t available = static_cast<size_t>(_step.file->available());
+      n = _step.file->readBytes(reinterpret_cast<char *>(buffer),
+                                n < available ? n : available);
+      if (n > 0 && !waavisWriteAll(client, buffer, n)) {
+        return false;
+      }
+    } else if (!waavisWriteAll(client, _step.data + _step.offset, n)) {
+      return false;
+    }
+    if (n > 0 && !reportUpload(n)) {
+      return false;
+    }
+    _step.offset += n;
+    if (_step.offset == _step.dataSize) {
+      _step.piece = 2;
+      _step.offset = 0;
+    }
+    return true;
+  }
+
+  const String &text = _step.piece == 0 ? _step.head : _step.tail;
+  size_t left = text.length() - _step.offset;
+  size_t n = left < room ? left : room;
+  if (n > 0 && !waavisWriteAll(client,
+                               reinterpret_cast<const uint8_t *>(text.c_str()) + _step.offset,
+                               n)) {
+    return false;
+  }
+  _step.offset += n;
+  if (_step.offset == text.length()) {
+    _step.piece = _step.piece == 0 ? (_step.dataSize > 0 ? 1 : 2) : 3;
+    _step.offset = 0;
+  }
+  return true;
+}
+
+// A non-blocking transport has no room yet: it is still connecting or in the
+// TLS handshake, or its send buffer is full. Nothing on a new connection
+// written means the connect itself failed.
+WaavisPollResult WaavisClient::stepWaitWritable(bool &waiting) {
+  bool closed = !_step.client->connected();
+  bool stalled = millis() - _step.since > kConnectTimeoutMs;
+  if (!closed && !stalled && waitBudget(1) != 0) {
+    waiting = true;
+    return WaavisPollResult::InProgress;
+  }
+  if (_step.state == StepState::Head && _step.offset == 0 && !_step.reused &&
+      waitBudget(1) != 0) {
+    stop();
+    _lastError = "HTTP connect failed";
+    WAAVIS_TRACE(ERROR, ConnectFailed, 2);
+    return stepFinish(false);
+  }
+  return stepFail(closed);
+}
+
+// The connection broke or a wait ran out. A kept-alive connection may have
+// been closed by the server while idle; like sendRequest, start over once on
+// a fresh one, but only if the server closed it (closed) before answering and
+// nothing unrepeatable has been consumed.
+WaavisPollResult WaavisClient::stepFail(bool closed) {
+  stop();
+  if (uploadCancelled()) {
+    _lastError = "Upload cancelled";
+    return stepFinish(false);
+  }
+  if (timedOut()) {
+    return stepFinish(false);
+  }
+  bool replayable = _step.file == nullptr || _step.piece == 0 ||
+                    (_step.piece == 1 && _step.offset == 0);
+  if (_step.reused && closed && replayable) {
+    WAAVIS_TRACE(INFO, StaleConnection, 0);
+    _step.reused = false;
+    _step.state = StepState::Connect;
+    return WaavisPollResult::InProgress;
+  }
+  _lastError = "HTTP connection lost";
+  return stepFinish(false);
+}
+
+WaavisPollResult WaavisClient::stepFinish(bool ok) {
+  timingEnd(_step.endpoint, ok);
+  _step.state = StepState::Idle;
+  _step.client = nullptr;
+  _step.file = nullptr;
+  _step.data = nullptr;
+  // Release the copies instead of keeping them until the next send.
+  _step.head = String();
+  _step.tail = String();
+  _step.request = String();
+  _step.token = String();
+#if defined(ESP32)
+  if (_step.locked) {
+    _step.locked = false;
+    xSemaphoreGiveRecursive(_ioLock);
+  }
+#endif
+  return ok ? WaavisPollResult::Done : WaavisPollResult::Failed;
+}
@@ -0,0 +1,135 @@
+#include "WaavisInternal.h"
+
+WaavisValue::WaavisValue(int value) : _kind(Kind::Signed), _decimals(0), _signed(value) {}
+
+WaavisValue::WaavisValue(long value) : _kind(Kind::Signed), _decimals(0), _signed(value) {}
+
+WaavisValue::WaavisValue(unsigned int value)
+    : _kind(Kind::Unsigned), _decimals(0), _unsigned(value) {}
+
+WaavisValue::WaavisValue(unsigned long value)
+    : _kind(Kind::Unsigned), _decimals(0), _unsigned(value) {}
+
+WaavisValue::WaavisValue(double value, uint8_t decimals)
+    : _kind(Kind::Float), _decimals(decimals > 6 ? 6 : decimals), _float(value) {}
+
+WaavisValue::WaavisValue(const char *text)
+    : _kind(Kind::Text), _decimals(0), _text(text != nullptr ? text : "") {}
+
+WaavisValue::WaavisValue(const String &text)
+    : _kind(Kind::Text), _decimals(0), _text(text.c_str()) {}
+
+bool WaavisValue::isText() const {
+  return _kind == Kind::Text;
+}
+
+const char *WaavisValue::text() const {
+  return _kind == Kind::Text ? _text : "";
+}
+
+// Writes value in decimal, right to left, ending at end; returns the start.
+static char *formatUnsigned(unsigned long long value, char *end) {
+  do {
+    *--end = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  return end;
+}
+
+size_t WaavisValue::formatNumber(char *out) const {
+  char digits[kMaxNumberLength];
+  char *end = digits + sizeof(digits);
+  char *start;
+  bool negative = false;
+  switch (_kind) {
+    case Kind::Signed:
+      negative = _signed < 0;
+      start = formatUnsigned(negative ? 0ULL - static_cast<unsigned long long>(_signed)
+                                      : static_cast<unsigned long long>(_signed),
+                             end);
+      break;
+    case Kind::Unsigned:
+      start = formatUnsigned(_unsigned, end);
+      break;
+    case Kind::Float: {
+      double value = _float;
+      if (value != value) {
+        memcpy(out, "nan", 3);
+        return 3;
+      }
+      negative = value < 0;
+      if (negative) {
+        value = -value;
+      }
+      unsigned long long scale = 1;
+      for (uint8_t i = 0; i < _decimals; ++i) {
+        scale *= 10;
+      }
+      // Fixed point keeps the rounding and digit count predictable; larger
+      // magnitudes are clamped rather than switching to exponent form.
+      double scaled = value * static_cast<double>(scale) + 0.5;
+      unsigned long long fixed = scaled < 1e18 ? static_cast<unsigned long long>(scaled)
+                                               : 999999999999999999ULL;
+      start = end;
+      if (_decimals > 0) {
+        unsigned long long fraction = fixed % scale;
+        for (uint8_t i = 0; i < _decimals; ++i) {
+          *--start = static_cast<char>('0' + fraction % 10);
+          fraction /= 10;
+        }
+        *--start = '.';
+      }
+      start = formatUnsigned(fixed / scale, start);
+      negative = negative && fixed != 0;
+      break;
+    }
+    default:
+      return 0;
+  }
+  size_t len = 0;
+  if (negative) {
+    out[len++] = '-';
+  }
+  memcpy(out + len, start, end - start);
+  return len + (end - start);
+}
+
+WaavisTemplate::WaavisTemplate(const char *pattern) : _fieldCount(0) {
+  static const char hex[] = "0123456789ABCDEF";
+  _encoded.reserve(strlen(pattern) + 16);
+  const char *p = pattern;
+  while (*p != '\0') {
+    if (*p == '{' && p[1] == '{') {
+      _encoded += "%7B";
+      p += 2;
+      continue;
+    }
+    if (*p == '{' && _fieldCount < kMaxFields) {
+      const char *close = strchr(p, '}');
+      if (close != nullptr) {
+        _segmentEnd[_fieldCount++] = static_cast<uint16_t>(_encoded.length());
+        p = close + 1;
+        continue;
+      }
+    }
+    char c = *p++;
+    if (waavisIsUnreserved(c)) {
+      _encoded += c;
+    } else {
+      _encoded += '%';
+      _encoded += hex[(c >> 4) & 0x0F];
+      _encoded += hex[c & 0x0F];
+    }
+  }
+  _segmentEnd[_fieldCount] = static_cast<uint16_t>(_encoded.length());
+}
+
+uint8_t WaavisTemplate::fieldCount() const {
+  return _fieldCount;
+}
+
+const char *WaavisTemplate::segment(uint8_t index, size_t &length) const {
+  uint16_t begin = index > 0 ? _segmentEnd[index - 1] : 0;
+  length = _segmentEnd[index] - begin;
+  return _encoded.c_str() + begin;
+}
@@ -0,0 +1,61 @@
+#ifndef WAAVIS_TEMPLATE_H
+#define WAAVIS_TEMPLATE_H
+
+#include <Arduino.h>
+
+// One field value for a WaavisTemplate. Numbers are formatted at send time
+// without String; text is borrowed and must outlive the send.
+class WaavisValue {
+public:
+  WaavisValue(int value);
+  WaavisValue(long value);
+  WaavisValue(unsigned int value);
+  WaavisValue(unsigned long value);
+  WaavisValue(double value, uint8_t decimals = 1);
+  WaavisValue(const char *text);
+  WaavisValue(const String &text);
+
+  // Longest formatted number, including sign and decimal point.
+  static const size_t kMaxNumberLength = 24;
+
+  bool isText() const;
+  const char *text() const;
+  // Writes a number's digits to out (kMaxNumberLength bytes) and returns
+  // their count. Digits, '-' and '.' need no URL encoding.
+  size_t formatNumber(char *out) const;
+
+private:
+  enum class Kind : uint8_t { Signed, Unsigned, Float, Text };
+
+  Kind _kind;
+  uint8_t _decimals;
+  union {
+    long _signed;
+    unsigned long _unsigned;
+    double _float;
+    const char *_text;
+  };
+};
+
+// Message text with "{name}" fields, e.g. "Tank {id} level {pct}% at {time}".
+// The text between fields is URL-encoded once here; a send only formats the
+// field values, in order of appearance (names are for readability). "{{"
+// is a literal '{'. Define templates once, e.g. as globals.
+class WaavisTemplate {
+public:
+  static const uint8_t kMaxFields = 8;
+
+  explicit WaavisTemplate(const char *pattern);
+
+  uint8_t fieldCount() const;
+  // Pre-encoded text before field index (index == fieldCount() gives the
+  // text after the last field).
+  const char *segment(uint8_t index, size_t &length) const;
+
+private:
+  String _encoded;
+  uint16_t _segmentEnd[kMaxFields + 1];
+  uint8_t _fieldCount;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "WaavisInternal.h"
+
+static const char *const kEventNames[] = {
+    "invalid_certificate", "tls_fragment_length", "timeout",
+    "invalid_base_url",    "https_disabled",      "dns_failed",
+    "connect_failed",      "saved_address_failed", "fingerprint_mismatch",
+    "http_error",          "stale_connection",    "wifi_down",
+    "upload_start",        "headers_sent",        "body_sent",
+    "upload_done",         "outbox_torn_record",  "outbox_open_failed",
+    "outbox_queued",       "outbox_truncated",    "outbox_dropped",
+    "relay_start",         "resume_failed",
+};
+
+static const char *const kLevelNames[] = {"", "E", "I", "V"};
+
+// Single ring shared by every client. The counters only grow; a record's
+// slot is its counter value modulo the capacity.
+static WaavisTraceRecord traceRing[WAAVIS_TRACE_SIZE];
+static uint32_t traceWritten = 0;
+static uint32_t traceRead = 0;
+static uint32_t traceDropped = 0;
+
+#if defined(ESP32)
+static portMUX_TYPE traceMux = portMUX_INITIALIZER_UNLOCKED;
+#define WAAVIS_TRACE_LOCK() portENTER_CRITICAL(&traceMux)
+#define WAAVIS_TRACE_UNLOCK() portEXIT_CRITICAL(&traceMux)
+#else
+#define WAAVIS_TRACE_LOCK() do {} while (0)
+#define WAAVIS_TRACE_UNLOCK() do {} while (0)
+#endif
+
+void waavisTrace(uint8_t level, WaavisEvent event, int32_t arg) {
+  uint32_t now = millis();
+  WAAVIS_TRACE_LOCK();
+  if (traceWritten - traceRead == WAAVIS_TRACE_SIZE) {
+    // Full: the oldest event gives way.
+    ++traceRead;
+    ++traceDropped;
+  }
+  WaavisTraceRecord &record = traceRing[traceWritten % WAAVIS_TRACE_SIZE];
+  record.ms = now;
+  record.event = event;
+  record.level = level;
+  record.arg = arg;
+  ++traceWritten;
+  WAAVIS_TRACE_UNLOCK();
+}
+
+size_t waavisTraceRead(WaavisTraceRecord *records, size_t max) {
+  size_t count = 0;
+  WAAVIS_TRACE_LOCK();
+  while (count < max && traceRead != traceWritten) {
+    records[count++] = traceRing[traceRead % WAAVIS_TRACE_SIZE];
+    ++traceRead;
+  }
+  WAAVIS_TRACE_UNLOCK();
+  return count;
+}
+
+uint32_t waavisTraceDropped() {
+  return traceDropped;
+}
+
+const char *waavisEventName(WaavisEvent event) {
+  size_t index = static_cast<size_t>(event);
+  return index < sizeof(kEventNames) / sizeof(kEventNames[0]) ? kEventNames[index] : "?";
+}
+
+size_t waavisTracePrint(Print &out) {
+  WaavisTraceRecord batch[8];
+  size_t total = 0;
+  size_t n;
+  while ((n = waavisTraceRead(batch, 8)) > 0) {
+    for (size_t i = 0; i < n; ++i) {
+      const WaavisTraceRecord &record = batch[i];
+      out.printf("[waavis] %lu %s %s %ld\n", static_cast<unsigned long>(record.ms),
+                 kLevelNames[record.level & 3], waavisEventName(record.event),
+                 static_cast<long>(record.arg));
+    }
+    total += n;
+  }
+  return total;
+}
+
+#if defined(ESP32)
+struct TraceDrain {
+  Print *out;
+  uint32_t periodMs;
+};
+
+static void traceTask(void *arg) {
+  TraceDrain *drain = static_cast<TraceDrain *>(arg);
+  while (true) {
+    waavisTracePrint(*drain->out);
+    vTaskDelay(pdMS_TO_TICKS(drain->periodMs));
+  }
+}
+
+bool waavisTraceBegin(Print &out, uint32_t periodMs) {
+  static TraceDrain drain;
+  static TaskHandle_t task = nullptr;
+  drain.out = &out;
+  drain.periodMs = periodMs > 0 ? periodMs : 1;
+  if (task != nullptr) {
+    return true;
+  }
+  return xTaskCreate(traceTask, "waavis-trace", 2560, &drain, tskIDLE_PRIORITY + 1,
+                     &task) == pdPASS;
+}
+#endif
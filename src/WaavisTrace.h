@@ -0,0 +1,58 @@
+#ifndef WAAVIS_TRACE_H
+#define WAAVIS_TRACE_H
+
+#include <Arduino.h>
+
+// Library events recorded into a fixed in-RAM ring instead of being printed.
+// Recording is a few stores; turning events into text happens when the ring
+// is drained, off the send path.
+enum class WaavisEvent : uint8_t {
+  InvalidCertificate,
+  TlsFragmentLength,   // arg: negotiated length, 0 if unsupported
+  Timeout,             // arg: WaavisPhase that did not complete
+  InvalidBaseUrl,
+  HttpsDisabled,
+  DnsFailed,
+  ConnectFailed,       // arg: 0 http, 1 https, 2 setTransport client
+  SavedAddressFailed,
+  FingerprintMismatch,
+  HttpError,           // arg: HTTP status, -1 if none
+  StaleConnection,
+  WiFiDown,
+  UploadStart,         // arg: file size, -1 if chunked
+  HeadersSent,
+  BodySent,
+  UploadDone,          // arg: bytes uploaded
+  OutboxTornRecord,
+  OutboxOpenFailed,
+  OutboxQueued,        // arg: messages pending
+  OutboxTruncated,
+  OutboxDropped,       // arg: HTTP status
+  RelayStart,          // arg: source size, -1 if unknown
+  ResumeFailed,
+};
+
+struct WaavisTraceRecord {
+  uint32_t ms;
+  WaavisEvent event;
+  uint8_t level;
+  int32_t arg;
+};
+
+// Copies up to max of the oldest recorded events to records and removes them
+// from the ring. Returns how many were copied.
+size_t waavisTraceRead(WaavisTraceRecord *records, size_t max);
+// Events overwritten before they were read.
+uint32_t waavisTraceDropped();
+const char *waavisEventName(WaavisEvent event);
+// Drains the ring to out, one line per event, e.g. from loop() on ESP8266.
+size_t waavisTracePrint(Print &out);
+#if defined(ESP32)
+// Drains the ring to out (Serial, or a File for flash) every periodMs from a
+// low-priority task.
+bool waavisTraceBegin(Print &out, uint32_t periodMs = 200);
+#endif
+
+void waavisTrace(uint8_t level, WaavisEvent event, int32_t arg);
+
+#endif